@@ -0,0 +1,109 @@
+#pragma once
+
+#include <new>
+#include <limits>
+#include <numeric>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+#include "ThreadAffinity.h"
+
+/// The alignment in bytes of every component array, large enough for a 512 bit vector register and a cache line
+constexpr std::size_t COMPONENT_ALIGNMENT = 64;
+
+/// The number of elements of T a kernel working on Alignment bytes at once needs to be able to touch without a
+/// scalar remainder loop, i.e. the smallest count of elements that fills a whole number of Alignment sized blocks
+template<typename T, std::size_t Alignment = COMPONENT_ALIGNMENT>
+inline constexpr std::size_t PaddingLanes = Alignment / std::gcd(Alignment, sizeof(T));
+
+/// Rounds count up to the next multiple of PaddingLanes<T, Alignment>
+template<typename T, std::size_t Alignment = COMPONENT_ALIGNMENT>
+constexpr std::size_t PaddedCount(std::size_t count)
+{
+	constexpr std::size_t lanes = PaddingLanes<T, Alignment>;
+	return (count + lanes - 1) / lanes * lanes;
+}
+
+/// An allocator returning memory aligned to Alignment bytes. Every allocation is padded up to a multiple of
+/// PaddingLanes<T, Alignment> elements, the padding behind the requested elements is zeroed.
+/// An allocator bound to a NUMA node first touches all of its memory from that node.
+/// \tparam T
+/// \tparam Alignment Must be a power of two
+template<typename T, std::size_t Alignment = COMPONENT_ALIGNMENT>
+class AlignedAllocator
+{
+public:
+	static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two!");
+	static_assert(Alignment >= alignof(T), "Alignment must not be smaller than the alignment of T!");
+	
+	using value_type = T;
+	
+	template<typename U>
+	struct rebind
+	{
+		using other = AlignedAllocator<U, Alignment>;
+	};
+	
+	// containers keep the NUMA node of the memory they take over
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+	
+	AlignedAllocator() noexcept = default;
+	
+	/// \param numaNode The NUMA node the memory is placed on, -1 to leave the placement to the operating system
+	explicit AlignedAllocator(int numaNode) noexcept
+			: _numaNode(numaNode)
+	{
+	}
+	
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment> &other) noexcept
+			: _numaNode(other.NumaNode())
+	{
+	}
+	
+	[[nodiscard]] int NumaNode() const noexcept
+	{
+		return _numaNode;
+	}
+	
+	T *allocate(std::size_t count)
+	{
+		if (count > std::numeric_limits<std::size_t>::max() / sizeof(T) - PaddingLanes<T, Alignment>)
+			throw std::bad_array_new_length();
+		
+		const std::size_t paddedCount = PaddedCount<T, Alignment>(count);
+		void *memory = ::operator new(paddedCount * sizeof(T), std::align_val_t(Alignment));
+		
+		if (_numaNode >= 0)
+		{
+			FirstTouchOnNumaNode(memory, paddedCount * sizeof(T), _numaNode);
+			return static_cast<T *>(memory);
+		}
+		
+		// the padding is never constructed, zero it so that kernels reading it see inert values
+		std::memset(static_cast<char *>(memory) + count * sizeof(T), 0, (paddedCount - count) * sizeof(T));
+		return static_cast<T *>(memory);
+	}
+	
+	void deallocate(T *memory, std::size_t) noexcept
+	{
+		::operator delete(memory, std::align_val_t(Alignment));
+	}
+	
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Alignment> &other) const noexcept
+	{
+		return _numaNode == other.NumaNode();
+	}
+	
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment> &other) const noexcept
+	{
+		return !(*this == other);
+	}
+
+private:
+	int _numaNode = -1;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "EntityID.h"
+#include "Span.h"
+
+class ECSManager;
+
+/// Per type lists of callbacks that are executed when components of ComponentType are added or removed.
+/// Hooks are called directly by the ECSManager without going through the ComponentViews, so types without any
+/// registered hook only pay for an empty check.
+/// Hooks must not add or remove components of ComponentType themselves.
+/// \tparam ComponentType Deriving from ComponentData
+template<typename ComponentType>
+struct ComponentHooks
+{
+public:
+	/// Receives a single component right after it was added or right before it gets removed
+	using Hook = std::function<void(ComponentType &component)>;
+	
+	/// Receives all entities that gained or are about to lose a component in a single call
+	using BatchHook = std::function<void(ECSManager &manager, Span<const EntityID> ids)>;
+	
+	static void AddOnAdd(Hook hook)
+	{
+		_onAdd.push_back(std::move(hook));
+	}
+	
+	static void AddOnRemove(Hook hook)
+	{
+		_onRemove.push_back(std::move(hook));
+	}
+	
+	static void AddOnAddBatch(BatchHook hook)
+	{
+		_onAddBatch.push_back(std::move(hook));
+	}
+	
+	static void AddOnRemoveBatch(BatchHook hook)
+	{
+		_onRemoveBatch.push_back(std::move(hook));
+	}
+	
+	/// Unregisters all hooks of ComponentType
+	static void Clear()
+	{
+		_onAdd.clear();
+		_onRemove.clear();
+		_onAddBatch.clear();
+		_onRemoveBatch.clear();
+	}
+	
+	[[nodiscard]] static bool HasAddHooks()
+	{
+		return !_onAdd.empty() || !_onAddBatch.empty();
+	}
+	
+	[[nodiscard]] static bool HasRemoveHooks()
+	{
+		return !_onRemove.empty() || !_onRemoveBatch.empty();
+	}
+
+private:
+	friend class ECSManager;
+	
+	template<typename>
+	friend
+	class ComponentVector;
+	
+	/// Runs the batch hooks once and the single hooks for every component in the batch
+	/// \param getComponent Maps an EntityID of ids to its component
+	template<typename GetComponent>
+	static void Invoke(const std::vector<Hook> &hooks, const std::vector<BatchHook> &batchHooks,
+	                   ECSManager &manager, Span<const EntityID> ids, GetComponent getComponent)
+	{
+		for (const BatchHook &batchHook : batchHooks)
+		{
+			batchHook(manager, ids);
+		}
+		
+		for (const Hook &hook : hooks)
+		{
+			for (EntityID id : ids)
+			{
+				hook(getComponent(id));
+			}
+		}
+	}
+	
+	inline static std::vector<Hook> _onAdd{};
+	inline static std::vector<Hook> _onRemove{};
+	inline static std::vector<BatchHook> _onAddBatch{};
+	inline static std::vector<BatchHook> _onRemoveBatch{};
+};
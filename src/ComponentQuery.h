@@ -0,0 +1,264 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <typeindex>
+#include "../libs/robin-map/include/tsl/robin_map.h"
+#include "TypeId.h"
+#include "ECSManager.h"
+#include "ComponentViewBase.h"
+
+/// Maintains the list of all entities owning every one of the ComponentTypes and the indices of their components.
+/// A ComponentQuery is shared by all ComponentViews of the same ComponentTypes in an ECSManager and unregisters
+/// itself from the manager once the last of them is destroyed.
+template<typename ...ComponentTypes>
+class ComponentQuery : public ComponentViewBase
+{
+public:
+	/// Returns the query the ECSManager holds for the ComponentTypes and creates it if there was none yet
+	/// \param manager
+	/// \return
+	static std::shared_ptr<ComponentQuery> Acquire(ECSManager &manager);
+	
+	/// Registers the query in the ECS Manager and gets all currently eligible entities
+	explicit ComponentQuery(ECSManager &manager);
+	
+	~ComponentQuery() override;
+	
+	ComponentQuery(const ComponentQuery &) = delete;
+	
+	ComponentQuery &operator=(const ComponentQuery &) = delete;
+	
+	/// Adds the id to the ComponentQuery if it owns all interesting components
+	/// \param type The ComponentId of the components type that was added
+	/// \param id The EntityID to which the component was added
+	void OnComponentAdded(ComponentId type, EntityID id) override;
+	
+	/// Removes the id from the ComponentQuery if it was registered
+	/// \param type The ComponentId of the components type that was removed
+	/// \param id The EntityID from which the component was removed
+	void OnComponentRemoved(ComponentId type, EntityID id) override;
+	
+	/// Updates the index of the component of the given type that the id owns
+	/// \param type The ComponentId of the components type that was moved
+	/// \param id The EntityID owning the moved component
+	/// \param newIndex The index of the component in its ComponentVector
+	void OnComponentMoved(ComponentId type, EntityID id, IndexType newIndex) override;
+	
+	/// Rebuilds the registered entities from the ComponentVectors of the manager
+	void Update() override;
+	
+	[[nodiscard]] QueryMemoryStats GetMemoryStats() const override;
+	
+	void ShrinkToFit(float minUsage) override;
+	
+	std::size_t Size() const;
+
+private:
+	template<typename ...>
+	friend
+	class ComponentView;
+	
+	/// Appends the id to the query, which needs to own all ComponentTypes
+	/// \param id
+	void Register(EntityID id);
+	
+	ECSManager &_manager;
+	
+	/// The ComponentIds of the types the ComponentQuery is interested in
+	std::vector<ComponentId> _operatingTypes;
+	
+	/// Maps EntityID to its position in the query. The component indices of the entity are
+	/// stored at _vectoredEntities[position * sizeof...(ComponentTypes)]
+	std::unique_ptr<tsl::robin_map<EntityID, IndexType>> _registeredEntities{};
+	
+	// saves the indices of the components of an entity behind next to each other
+	std::unique_ptr<std::vector<IndexType> > _vectoredEntities{};
+	
+	/// The EntityID at every position of the query
+	std::unique_ptr<std::vector<EntityID> > _viewedEntities{};
+};
+
+
+template<typename... ComponentTypes>
+std::shared_ptr<ComponentQuery<ComponentTypes...>> ComponentQuery<ComponentTypes...>::Acquire(ECSManager &manager)
+{
+	const std::type_index key(typeid(ComponentQuery));
+	
+	auto found = manager._queries.find(key);
+	if (found != manager._queries.end())
+	{
+		if (std::shared_ptr<ComponentViewBase> query = found->second.lock())
+			return std::static_pointer_cast<ComponentQuery>(query);
+	}
+	
+	auto query = std::make_shared<ComponentQuery>(manager);
+	manager._queries.insert_or_assign(key, std::weak_ptr<ComponentViewBase>(query));
+	return query;
+}
+
+template<typename... ComponentTypes>
+ComponentQuery<ComponentTypes...>::ComponentQuery(ECSManager &manager)
+		:_manager(manager)
+{
+	_operatingTypes = {TypeId<ComponentTypes>::GetId()...};
+	(_queryMask.set(TypeId<ComponentTypes>::GetId()), ...);
+	
+	_vectoredEntities = std::make_unique<std::vector<IndexType>>();
+	_vectoredEntities->reserve(16);
+	
+	_viewedEntities = std::make_unique<std::vector<EntityID>>();
+	
+	_registeredEntities = std::make_unique<tsl::robin_map<EntityID, IndexType>>();
+	
+	// register in entity system with types
+	_manager.RegisterComponentSystem(this, _operatingTypes);
+	
+	// fill registeredEntities
+	Update();
+}
+
+template<typename... ComponentTypes>
+ComponentQuery<ComponentTypes...>::~ComponentQuery()
+{
+	// the manager detaches all systems when it is destroyed first
+	if (!IsRegistered())
+		return;
+	
+	_manager.UnregisterComponentSystem(this);
+	_manager._queries.erase(std::type_index(typeid(ComponentQuery)));
+}
+
+template<typename... ComponentTypes>
+void ComponentQuery<ComponentTypes...>::OnComponentAdded(ComponentId, EntityID id)
+{
+	// the ECSManager only notifies the query if the entity owns all ComponentTypes now
+	if (_registeredEntities->count(id))
+		return;
+	
+	Register(id);
+}
+
+template<typename... ComponentTypes>
+void ComponentQuery<ComponentTypes...>::OnComponentRemoved(ComponentId, EntityID id)
+{
+	auto found = _registeredEntities->find(id);
+	if (found == _registeredEntities->end())
+		return;
+	
+	constexpr std::size_t nTypes = sizeof...(ComponentTypes);
+	const IndexType position = found->second;
+	const IndexType lastPosition = static_cast<IndexType>(_viewedEntities->size() - 1);
+	_registeredEntities->erase(found);
+	
+	// move the last entity into the gap
+	if (position != lastPosition)
+	{
+		for (std::size_t i = 0; i < nTypes; ++i)
+		{
+			(*_vectoredEntities)[position * nTypes + i] = (*_vectoredEntities)[lastPosition * nTypes + i];
+		}
+		
+		const EntityID movedId = (*_viewedEntities)[lastPosition];
+		(*_viewedEntities)[position] = movedId;
+		_registeredEntities->find(movedId).value() = position;
+	}
+	
+	_vectoredEntities->resize(lastPosition * nTypes);
+	_viewedEntities->pop_back();
+}
+
+template<typename... ComponentTypes>
+void ComponentQuery<ComponentTypes...>::OnComponentMoved(ComponentId type, EntityID id, IndexType newIndex)
+{
+	auto found = _registeredEntities->find(id);
+	if (found == _registeredEntities->end())
+		return;
+	
+	const std::size_t start = found->second * sizeof...(ComponentTypes);
+	for (std::size_t i = 0; i < _operatingTypes.size(); ++i)
+	{
+		if (_operatingTypes[i] == type)
+			(*_vectoredEntities)[start + i] = newIndex;
+	}
+}
+
+template<typename... ComponentTypes>
+void ComponentQuery<ComponentTypes...>::Register(EntityID id)
+{
+	_registeredEntities->insert(std::pair(id, static_cast<IndexType>(_viewedEntities->size())));
+	_viewedEntities->push_back(id);
+	(_vectoredEntities->push_back(_manager.GetComponents<ComponentTypes>()->IndexOf(id)), ...);
+}
+
+template<typename... ComponentTypes>
+std::size_t ComponentQuery<ComponentTypes...>::Size() const
+{
+	return _registeredEntities->size();
+}
+
+template<typename... ComponentTypes>
+void ComponentQuery<ComponentTypes...>::Update()
+{
+	_manager.AssertNotIterating();
+	
+	// init data structures
+	_vectoredEntities->clear();
+	_vectoredEntities->reserve(16);
+	
+	_viewedEntities->clear();
+	_registeredEntities->clear();
+	
+	
+	// look for already registered components in the system
+	if ((_manager.GetComponents<ComponentTypes>() && ...))
+	{
+		ComponentVectorBase *startComponents = _manager.GetComponentsBase(_operatingTypes[0]);
+		
+		// search for smallest component vector to minimize work
+		for (ComponentId currId : _operatingTypes)
+		{
+			ComponentVectorBase *currComponents = _manager.GetComponentsBase(currId);
+			if (currComponents->Size() < startComponents->Size())
+			{
+				startComponents = currComponents;
+			}
+		}
+		
+		// register the ids of the smallest componentVector whose entity owns all the other components as well
+		for (const auto &currPair : startComponents->getEntities())
+		{
+			const Entity *pEntity = _manager.GetEntity(currPair.first);
+			
+			if (pEntity && (pEntity->signature & _queryMask) == _queryMask)
+				Register(currPair.first);
+		}
+	}
+}
+
+template<typename... ComponentTypes>
+QueryMemoryStats ComponentQuery<ComponentTypes...>::GetMemoryStats() const
+{
+	QueryMemoryStats stats{};
+	((stats.types += (stats.types.empty() ? "" : ", ") + ComponentSerializer<ComponentTypes>::Name()), ...);
+	stats.count = Size();
+	stats.vectoredEntitiesBytes = _vectoredEntities->capacity() * sizeof(IndexType);
+	stats.registeredEntitiesBytes = BucketBytes(*_registeredEntities);
+	stats.registeredEntitiesLoadFactor = _registeredEntities->load_factor();
+	stats.viewedEntitiesBytes = _viewedEntities->capacity() * sizeof(EntityID);
+	return stats;
+}
+
+template<typename... ComponentTypes>
+void ComponentQuery<ComponentTypes...>::ShrinkToFit(float minUsage)
+{
+	_manager.AssertNotIterating();
+	
+	if (IsWorthShrinking(_viewedEntities->size(), _viewedEntities->capacity(), minUsage))
+	{
+		_viewedEntities->shrink_to_fit();
+		_vectoredEntities->shrink_to_fit();
+	}
+	
+	ShrinkBuckets(*_registeredEntities, minUsage);
+}
@@ -1,8 +1,20 @@
 #pragma once
 
 #include <vector>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include "../libs/robin-map/include/tsl/robin_map.h"
 #include "ComponentData.h"
+#include "AlignedAllocator.h"
+#include "ComponentHooks.h"
+#include "Snapshot.h"
+#include "MemoryStats.h"
 
 
 constexpr IndexType BASE_ENTITY_VECTOR_SIZE = 16;
@@ -15,47 +27,238 @@ class ComponentVectorBase
 public:
 	ComponentVectorBase()
 	{
-		entityIndex = new tsl::robin_map<EntityID, IndexType>();
+		entityIndex = std::make_shared<tsl::robin_map<EntityID, IndexType>>();
 	}
 	
 	virtual ~ComponentVectorBase() = default;
 	
-	virtual void RemoveComponentFrom(EntityID id) = 0;
+	/// Removes the component of id and executes the OnRemove hooks of its type
+	/// \return The EntityID whose component was moved into the place of the removed one or an invalid EntityID if
+	/// no component was moved
+	virtual EntityID RemoveComponentFrom(EntityID id) = 0;
+	
+	/// Removes the component of id without executing hooks
+	/// \return The EntityID whose component was moved into the place of the removed one or an invalid EntityID if
+	/// no component was moved
+	virtual EntityID EraseComponent(EntityID id) = 0;
+	
+	/// Moves the components at the indices to the end of destination, which needs to hold the same type, and gives
+	/// them the newIds. The moved components stay behind in a moved-from state until they are erased.
+	/// \param destination
+	/// \param indices Ascending indices, neighbouring indices are moved as one block
+	/// \param newIds The id of every moved component in destination
+	virtual void MoveComponentsTo(ComponentVectorBase &destination, Span<const IndexType> indices,
+	                              Span<const EntityID> newIds) = 0;
+	
+	/// Moves all components into memory placed on the numaNode. Indices of the components stay the same
+	/// \param numaNode -1 to leave the placement to the operating system
+	virtual void BindToNumaNode(int numaNode) = 0;
+	
+	/// \return The name identifying the type of the components in snapshots
+	[[nodiscard]] virtual const std::string &SnapshotName() const = 0;
+	
+	/// Writes the ids and components into a snapshot
+	virtual void WriteSnapshot(SnapshotWriter &writer) const = 0;
+	
+	/// Replaces all components with the ones written by WriteSnapshot. Hooks are not executed and the map from
+	/// EntityID to index is only rebuilt when it is first used, so types that are never looked up after loading a
+	/// snapshot do not hash any of their ids.
+	/// \return false if the snapshot is truncated or was written for a different component layout
+	virtual bool ReadSnapshot(SnapshotReader &reader) = 0;
+	
+	/// \return The id owning the component at index
+	[[nodiscard]] virtual EntityID IdAt(IndexType index) const = 0;
+	
+	/// Creates an empty ComponentVector of the same type
+	/// \param owner The manager of the created ComponentVector
+	/// \param numaNode -1 to leave the placement to the operating system
+	[[nodiscard]] virtual ComponentVectorBase *CreateEmpty(ECSManager *owner, int numaNode) const = 0;
+	
+	/// Replaces all components with copies of the ones of source, which needs to hold the same type. Hooks are not
+	/// executed. Needs IsCopyable.
+	/// \param withEntityIndex false keeps the map from EntityID to index, which is only correct if the same ids
+	/// owned components at the same indices in both ComponentVectors
+	virtual void CopyFrom(const ComponentVectorBase &source, bool withEntityIndex) = 0;
+	
+	/// Removes all components without executing hooks
+	virtual void Clear() = 0;
+	
+	/// \return Whether the components can be copied, which CopyFrom and sharing them with a fork rely on
+	[[nodiscard]] virtual bool IsCopyable() const = 0;
+	
+	/// Creates a ComponentVector of the same type that shares the components with this one until either of them
+	/// is changed. Needs IsCopyable.
+	/// \param owner The manager of the created ComponentVector
+	[[nodiscard]] virtual ComponentVectorBase *Fork(ECSManager *owner) = 0;
+	
+	/// \return The memory held by the components and the map from EntityID to index
+	[[nodiscard]] virtual ComponentMemoryStats GetMemoryStats() const = 0;
+	
+	/// Gives back the memory of the component array and the map from EntityID to index if they use less than
+	/// minUsage of it. Indices of the components stay the same, references to them become invalid. Components
+	/// shared with a fork are left alone, as shrinking them would copy them.
+	virtual void ShrinkToFit(float minUsage) = 0;
+	
+	/// Marks the components as written since the last ECSManager::SaveState or RestoreState, which copy only
+	/// ComponentVectors marked this way, and copies components shared with a fork. Needs to be called before any
+	/// component is written. Safe to call from multiple threads at once.
+	void MarkChanged()
+	{
+		_stateStamp.store(0, std::memory_order_relaxed);
+		if (_isShared.load(std::memory_order_acquire))
+			Unshare();
+	}
+	
+	/// Marks that components were added, removed or moved, besides MarkChanged
+	void MarkLayoutChanged()
+	{
+		MarkChanged();
+		_layoutStamp = 0;
+	}
 	
 	
 	/// \return a map containing all entities in the ComponentVector
 	[[nodiscard]] const tsl::robin_map<EntityID, IndexType> &getEntities() const
 	{
+		return EntityIndex();
+	}
+	
+	/// \return The number of components
+	[[nodiscard]] virtual std::size_t Size() const = 0;
+
+protected:
+	friend class ECSManager;
+	
+	/// Maps an EntityID to the index of the component it owns. Empty while _isEntityIndexStale is set, use
+	/// EntityIndex instead.
+	std::shared_ptr<tsl::robin_map<EntityID, IndexType>> entityIndex;
+	
+	/// Whether entityIndex still needs to be rebuilt from the ids of the components after ReadSnapshot
+	mutable std::atomic<bool> _isEntityIndexStale{false};
+	
+	/// Makes sure only one thread rebuilds a stale entityIndex
+	mutable std::mutex _entityIndexMutex;
+	
+	/// \return The map from EntityID to index, which is rebuilt first if it is stale. Safe to call from multiple
+	/// threads at once.
+	tsl::robin_map<EntityID, IndexType> &EntityIndex() const
+	{
+		if (_isEntityIndexStale.load(std::memory_order_acquire))
+		{
+			std::lock_guard<std::mutex> lock(_entityIndexMutex);
+			if (_isEntityIndexStale.load(std::memory_order_relaxed))
+			{
+				RebuildEntityIndex();
+				_isEntityIndexStale.store(false, std::memory_order_release);
+			}
+		}
 		return *entityIndex;
 	}
 	
-	size_t Size()
+	/// Rebuilds the map from EntityID to index from the ids stored in the components
+	virtual void RebuildEntityIndex() const = 0;
+	
+	/// Whether the components or entityIndex may be shared with a fork
+	std::atomic<bool> _isShared{false};
+	
+	/// Makes sure only one thread copies shared components or forks them
+	std::mutex _unshareMutex;
+	
+	/// Copies the components and entityIndex if another ComponentVector still shares them
+	virtual void Unshare() = 0;
+	
+	/// The ComponentVectors sharing the same components after Fork. The mutex is held while any member reads or
+	/// writes the shared components as a whole, i.e. while it copies them or changes ComponentData::manager, and
+	/// while a member changes which components it holds, so that a member is never adopting components another
+	/// one is copying.
+	struct ForkGroup
 	{
-		return entityIndex->size();
+		std::mutex mutex;
+		
+		std::vector<ComponentVectorBase *> members;
+	};
+	
+	/// The group of ComponentVectors this one shares its components with, nullptr if it shares them with none.
+	/// Only changed while _unshareMutex is held or on destruction.
+	std::shared_ptr<ForkGroup> _forkGroup;
+	
+	/// Adds fork to the ComponentVectors sharing the components of this one. Needs _unshareMutex to be held.
+	void JoinForkGroup(ComponentVectorBase &fork)
+	{
+		// no other ComponentVector knows a group created here yet
+		if (!_forkGroup)
+		{
+			_forkGroup = std::make_shared<ForkGroup>();
+			_forkGroup->members.push_back(this);
+		}
+		
+		const std::lock_guard<std::mutex> lock(_forkGroup->mutex);
+		_forkGroup->members.push_back(&fork);
+		fork._forkGroup = _forkGroup;
 	}
-
-protected:
-	/// Maps an EntityID to the index of the component it owns
-	tsl::robin_map<EntityID, IndexType> *entityIndex;
+	
+	/// Stops sharing the components with the other members of the fork group, after this ComponentVector copied them
+	/// or when it is destroyed. The components may point to the manager of this ComponentVector in
+	/// ComponentData::manager, so they are made to point to a manager that still holds them. Needs _unshareMutex to
+	/// be held unless called on destruction.
+	/// \param copyShared Replaces the shared components of this ComponentVector with its own copy, which runs while
+	/// no other member changes ComponentData::manager of the shared ones
+	template<typename Copy>
+	void LeaveForkGroup(Copy copyShared)
+	{
+		if (!_forkGroup)
+			return;
+		
+		// the last member frees the group, which needs to outlive the lock
+		const std::shared_ptr<ForkGroup> group = std::move(_forkGroup);
+		const std::lock_guard<std::mutex> lock(group->mutex);
+		copyShared();
+		
+		std::vector<ComponentVectorBase *> &members = group->members;
+		members.erase(std::find(members.begin(), members.end(), this));
+		if (!members.empty())
+			members.front()->AdoptSharedComponents();
+	}
+	
+	/// Makes ComponentData::manager of all components point to the manager of this ComponentVector. Needs the
+	/// mutex of the fork group to be held, which keeps the components of a member from being replaced.
+	virtual void AdoptSharedComponents() = 0;
+	
+	/// The stamp of the saved copy the components equal, 0 if they changed since they were saved or restored
+	std::atomic<std::uint64_t> _stateStamp{0};
+	
+	/// The same as _stateStamp for which ids own the components at which index
+	std::uint64_t _layoutStamp{0};
 };
 
+/// Stores all components of a type in a contiguous array aligned to COMPONENT_ALIGNMENT bytes, whose memory is
+/// always padded up to a multiple of Lanes components
 template<typename ComponentType>
 class ComponentVector : public ComponentVectorBase
 {
 public:
-	ComponentVector()
+	using Storage = std::vector<ComponentType, AlignedAllocator<ComponentType>>;
+	
+	/// The number of components a vectorized kernel may process at once without a scalar remainder loop.
+	/// The array is readable and writable up to PaddedSize(). The slots behind Size() are zeroed whenever the number
+	/// of components changes, values written to them are ignored.
+	static constexpr std::size_t Lanes = PaddingLanes<ComponentType>;
+	
+	/// \param numaNode The NUMA node the components are placed on, -1 to leave the placement to the operating system
+	explicit ComponentVector(int numaNode = -1)
 			: ComponentVectorBase()
 	{
 		static_assert(std::is_base_of<ComponentData, ComponentType>::value, "Must derive from ComponentData!");
+		static_cast<void>(_isSnapshotType);
 		
-		_components = new std::vector<ComponentType>();
+		_components = std::make_shared<Storage>(AlignedAllocator<ComponentType>(numaNode));
 		_components->reserve(BASE_ENTITY_VECTOR_SIZE);
 	}
 	
 	~ComponentVector() override
 	{
-		delete _components;
-		delete entityIndex;
+		// left while the components are still alive, as other members of the group may adopt them until then
+		LeaveForkGroup([]() {});
 	}
 	
 	ECSManager* manager{nullptr};
@@ -65,38 +268,494 @@ private:
 	friend
 	class ComponentView;
 	
-	std::vector<ComponentType> *_components;
+	friend class ECSManager;
+	
+	/// Shared with forks until either side changes a component
+	std::shared_ptr<Storage> _components;
+	
+	/// Makes ComponentType loadable from snapshots before main runs
+	static bool RegisterSnapshotType()
+	{
+		SnapshotTypes().push_back(SnapshotType{
+				&ComponentSerializer<ComponentType>::Name,
+				&TypeId<ComponentType>::GetId,
+				[](ECSManager *manager, int numaNode) -> ComponentVectorBase *
+				{
+					auto *components = new ComponentVector(numaNode);
+					components->manager = manager;
+					return components;
+				}});
+		return true;
+	}
+	
+	inline static const bool _isSnapshotType = RegisterSnapshotType();
+	
+	/// Creates a ComponentType from args, falling back to aggregate initialization for
+	/// components without a matching constructor
+	template<typename ...Args>
+	static ComponentType Construct(Args &&... args)
+	{
+		if constexpr (std::is_constructible_v<ComponentType, Args &&...>)
+			return ComponentType(std::forward<Args>(args)...);
+		else
+			return ComponentType{ComponentData(), std::forward<Args>(args)...};
+	}
+
+	/// Moves the component at index from into the slot at index to. The slot at from is left in a
+	/// moved-from state that only needs to be destroyed. Components owning memory hand it over instead of copying
+	/// it, trivially copyable ones are copied as bytes by their move assignment.
+	void Relocate(IndexType from, IndexType to)
+	{
+		(*_components)[to] = std::move((*_components)[from]);
+	}
+
+	/// Zeroes the slots between Size() and PaddedSize(), which may hold removed components or memory the vector
+	/// reserved but never initialized
+	void ClearPadding()
+	{
+		const std::size_t size = _components->size();
+		const std::size_t paddedSize = PaddedSize();
+		if (size != paddedSize)
+			std::memset(static_cast<void *>(_components->data() + size), 0, (paddedSize - size) * sizeof(ComponentType));
+	}
+	
+	/// Executes the OnAdd hooks of ComponentType for ids, which all need to own a component
+	void RunAddHooks(Span<const EntityID> ids)
+	{
+		ComponentHooks<ComponentType>::Invoke(ComponentHooks<ComponentType>::_onAdd,
+		                                      ComponentHooks<ComponentType>::_onAddBatch,
+		                                      *manager, ids,
+		                                      [this](EntityID id) -> ComponentType & { return (*this)[IndexOf(id)]; });
+	}
+	
+	/// Executes the OnRemove hooks of ComponentType for ids, which all need to own a component
+	void RunRemoveHooks(Span<const EntityID> ids)
+	{
+		// the hooks may write the components
+		MarkChanged();
+		ComponentHooks<ComponentType>::Invoke(ComponentHooks<ComponentType>::_onRemove,
+		                                      ComponentHooks<ComponentType>::_onRemoveBatch,
+		                                      *manager, ids,
+		                                      [this](EntityID id) -> ComponentType & { return (*this)[IndexOf(id)]; });
+	}
 
 public:
 	ComponentType &AddComponent(EntityID id)
 	{
 		// should not add component if it is already there
-		if (entityIndex->count(id))
-			return (*_components)[(*entityIndex)[id]];
+		const tsl::robin_map<EntityID, IndexType> &index = EntityIndex();
+		auto found = index.find(id);
+		if (found != index.end())
+		{
+			MarkChanged();
+			return (*_components)[found->second];
+		}
+		
+		return EmplaceComponent(id);
+	}
+	
+	/// Constructs a component for the id directly inside the component array.
+	/// If the id already owns a component it is replaced by the newly constructed one.
+	/// \param id Owner of the Component
+	/// \param args Arguments forwarded to the constructor of ComponentType
+	/// \return A reference that stays valid until the next component of this type is added or removed
+	template<typename ...Args>
+	ComponentType &EmplaceComponent(EntityID id, Args &&... args)
+	{
+		const tsl::robin_map<EntityID, IndexType> &index = EntityIndex();
+		auto found = index.find(id);
+		if (found != index.end())
+		{
+			MarkChanged();
+			ComponentType &component = (*_components)[found->second];
+			component = Construct(std::forward<Args>(args)...);
+			component.id = id;
+			component.manager = manager;
+			return component;
+		}
+		
+		// copies the map if it is shared with a fork, so it is looked up again
+		MarkLayoutChanged();
+		EntityIndex().insert(std::pair(id, _components->size()));
+		
+		if constexpr (std::is_constructible_v<ComponentType, Args &&...>)
+			_components->emplace_back(std::forward<Args>(args)...);
+		else
+			_components->push_back(Construct(std::forward<Args>(args)...));
+		ClearPadding();
+		
+		ComponentType &component = _components->back();
+		component.id = id;
+		component.manager = manager;
+		return component;
+	}
+	
+	EntityID RemoveComponentFrom(EntityID id) override
+	{
+		if (ComponentHooks<ComponentType>::HasRemoveHooks() && Contains(id))
+			RunRemoveHooks(Span<const EntityID>(&id, 1));
+		
+		return RemoveComponent(id);
+	}
+	
+	EntityID EraseComponent(EntityID id) override
+	{
+		return RemoveComponent(id);
+	}
+	
+	void MoveComponentsTo(ComponentVectorBase &destination, Span<const IndexType> indices,
+	                      Span<const EntityID> newIds) override
+	{
+		assert(indices.Size() == newIds.Size());
+		
+		auto &target = static_cast<ComponentVector &>(destination);
+		MarkChanged();
+		target.MarkLayoutChanged();
+		
+		const std::size_t begin = target._components->size();
+		target._components->reserve(begin + indices.Size());
+		
+		// every run of neighbouring components is appended by a single insert, which boils down to a memmove for
+		// trivially copyable components
+		std::size_t runBegin = 0;
+		while (runBegin < indices.Size())
+		{
+			std::size_t runEnd = runBegin + 1;
+			while (runEnd < indices.Size() && indices[runEnd] == indices[runEnd - 1] + 1)
+			{
+				++runEnd;
+			}
+			
+			const auto first = _components->begin() + indices[runBegin];
+			target._components->insert(target._components->end(), std::make_move_iterator(first),
+			                           std::make_move_iterator(first + static_cast<std::ptrdiff_t>(runEnd - runBegin)));
+			runBegin = runEnd;
+		}
+		target.ClearPadding();
+		
+		tsl::robin_map<EntityID, IndexType> &targetIndex = target.EntityIndex();
+		targetIndex.reserve(targetIndex.size() + newIds.Size());
+		for (std::size_t i = 0; i < newIds.Size(); ++i)
+		{
+			ComponentType &component = (*target._components)[begin + i];
+			component.id = newIds[i];
+			component.manager = target.manager;
+			targetIndex.insert(std::pair(newIds[i], static_cast<IndexType>(begin + i)));
+		}
+	}
+	
+	void BindToNumaNode(int numaNode) override
+	{
+		if (_components->get_allocator().NumaNode() == numaNode)
+			return;
+		
+		// components shared with a fork must not be moved from
+		if (_isShared.load(std::memory_order_acquire))
+			Unshare();
+		
+		auto bound = std::make_shared<Storage>(AlignedAllocator<ComponentType>(numaNode));
+		bound->reserve(std::max<std::size_t>(_components->capacity(), BASE_ENTITY_VECTOR_SIZE));
+		bound->insert(bound->end(), std::make_move_iterator(_components->begin()),
+		              std::make_move_iterator(_components->end()));
+		
+		_components = std::move(bound);
+		ClearPadding();
+	}
+	
+	[[nodiscard]] const std::string &SnapshotName() const override
+	{
+		return ComponentSerializer<ComponentType>::Name();
+	}
+	
+	void WriteSnapshot(SnapshotWriter &writer) const override
+	{
+		using Serializer = ComponentSerializer<ComponentType>;
+		
+		// components that can neither be copied as bytes nor serialized are left out of the snapshot
+		SnapshotEncoding encoding = SnapshotEncoding::Raw;
+		if (Serializer::HasSerializer())
+			encoding = SnapshotEncoding::Serializer;
+		else if constexpr (!std::is_trivially_copyable_v<ComponentType>)
+			encoding = SnapshotEncoding::Skipped;
+		const std::size_t count = encoding == SnapshotEncoding::Skipped ? 0 : _components->size();
+		
+		writer.WriteValue(static_cast<std::uint32_t>(sizeof(ComponentType)));
+		writer.WriteValue(encoding);
+		writer.WriteValue(static_cast<std::uint64_t>(count));
+		
+		if (encoding == SnapshotEncoding::Serializer)
+		{
+			writer.MarkBoundary();
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				Serializer::_write((*_components)[i], writer);
+			}
+		} else if constexpr (std::is_trivially_copyable_v<ComponentType>)
+		{
+			writer.Align(SNAPSHOT_ARRAY_ALIGNMENT);
+			writer.MarkBoundary();
+			writer.WriteArray(Span<const ComponentType>(_components->data(), count));
+		}
+		
+		writer.WriteEntityIds(count, [this](std::size_t i) { return (*_components)[i].id; });
+	}
+	
+	bool ReadSnapshot(SnapshotReader &reader) override
+	{
+		using Serializer = ComponentSerializer<ComponentType>;
+		const auto componentSize = reader.ReadValue<std::uint32_t>();
+		const auto encoding = reader.ReadValue<SnapshotEncoding>();
+		const auto count = reader.ReadValue<std::uint64_t>();
+		if (reader.Failed() || count > std::numeric_limits<IndexType>::max())
+			return false;
+		
+		Clear();
+		
+		if (encoding == SnapshotEncoding::Raw)
+		{
+			if constexpr (std::is_trivially_copyable_v<ComponentType>)
+			{
+				if (componentSize != sizeof(ComponentType) || !reader.Align(SNAPSHOT_ARRAY_ALIGNMENT))
+					return false;
+				
+				// copy straight from snapshots held in memory instead of initializing the array first
+				const std::size_t nBytes = count * sizeof(ComponentType);
+				const char *source = reader.Borrow(nBytes);
+				if (source && reinterpret_cast<std::uintptr_t>(source) % alignof(ComponentType) == 0)
+				{
+					const auto *components = reinterpret_cast<const ComponentType *>(source);
+					_components->assign(components, components + count);
+				} else if (source)
+				{
+					_components->resize(count);
+					std::memcpy(static_cast<void *>(_components->data()), source, nBytes);
+				} else
+				{
+					if (reader.Failed())
+						return false;
+					
+					_components->resize(count);
+					if (count != 0 && !reader.Read(_components->data(), nBytes))
+						return false;
+				}
+			} else
+			{
+				return false;
+			}
+		} else if (encoding == SnapshotEncoding::Skipped)
+		{
+			if (count != 0)
+				return false;
+		} else if (encoding == SnapshotEncoding::Serializer && Serializer::HasSerializer())
+		{
+			_components->reserve(count);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				Serializer::_read(_components->emplace_back(), reader);
+				if (reader.Failed())
+					return false;
+			}
+		} else
+		{
+			return false;
+		}
+		ClearPadding();
+		
+		for (ComponentType &component : *_components)
+		{
+			component.manager = manager;
+		}
+		
+		const bool isRead = reader.ReadEntityIds(count, [this](std::size_t i) -> EntityID &
+		{
+			return (*_components)[i].id;
+		});
+		_isEntityIndexStale.store(count != 0, std::memory_order_release);
+		return isRead;
+	}
+	
+	[[nodiscard]] EntityID IdAt(IndexType index) const override
+	{
+		return (*_components)[index].id;
+	}
+	
+	[[nodiscard]] std::size_t Size() const override
+	{
+		return _components->size();
+	}
+	
+	void RebuildEntityIndex() const override
+	{
+		entityIndex->clear();
+		entityIndex->reserve(_components->size());
+		for (std::size_t i = 0; i < _components->size(); ++i)
+		{
+			entityIndex->insert(std::pair((*_components)[i].id, static_cast<IndexType>(i)));
+		}
+	}
+	
+	[[nodiscard]] ComponentVectorBase *CreateEmpty(ECSManager *owner, int numaNode) const override
+	{
+		auto *components = new ComponentVector(numaNode);
+		components->manager = owner;
+		return components;
+	}
+	
+	void CopyFrom(const ComponentVectorBase &source, bool withEntityIndex) override
+	{
+		const auto &sourceComponents = static_cast<const ComponentVector &>(source);
+		
+		// the memory of the vector is reused and filled by a memcpy if ComponentType is trivially copyable
+		MarkLayoutChanged();
+		if constexpr (std::is_copy_constructible_v<ComponentType>)
+			_components->assign(sourceComponents._components->begin(), sourceComponents._components->end());
+		else
+			assert(false && "Components that are not copyable can not be copied!");
+		ClearPadding();
+		
+		if (withEntityIndex)
+		{
+			*entityIndex = sourceComponents.EntityIndex();
+			_isEntityIndexStale.store(false, std::memory_order_release);
+		}
+	}
+	
+	[[nodiscard]] bool IsCopyable() const override
+	{
+		return std::is_copy_constructible_v<ComponentType>;
+	}
+	
+	[[nodiscard]] ComponentVectorBase *Fork(ECSManager *owner) override
+	{
+		assert(IsCopyable() && "Components that are not copyable can not be shared with a fork!");
+		
+		// the map is shared as well, so it is rebuilt before either side may look up components
+		static_cast<void>(EntityIndex());
 		
-		entityIndex->insert(std::pair(id, _components->size()));
+		const std::lock_guard<std::mutex> lock(_unshareMutex);
+		auto *fork = new ComponentVector(_components->get_allocator().NumaNode());
+		fork->manager = owner;
+		fork->_components = _components;
+		fork->entityIndex = entityIndex;
+		fork->_isShared = true;
+		_isShared = true;
+		JoinForkGroup(*fork);
+		return fork;
+	}
+	
+	[[nodiscard]] ComponentMemoryStats GetMemoryStats() const override
+	{
+		ComponentMemoryStats stats{};
+		stats.type = TypeId<ComponentType>::GetId();
+		stats.name = SnapshotName();
+		stats.elementSize = sizeof(ComponentType);
+		stats.count = _components->size();
+		stats.capacity = _components->capacity();
+		stats.componentBytes = PaddedCount<ComponentType>(stats.capacity) * sizeof(ComponentType);
+		stats.entityIndexBytes = BucketBytes(*entityIndex);
+		stats.entityIndexLoadFactor = entityIndex->load_factor();
+		stats.isShared = _components.use_count() > 1;
+		return stats;
+	}
+	
+	void ShrinkToFit(float minUsage) override
+	{
+		if (_isShared.load(std::memory_order_acquire))
+			return;
 		
-		_components->push_back(ComponentType());
-		_components->back().id = id;
-		_components->back().manager = manager;
+		if (IsWorthShrinking(_components->size(), _components->capacity(), minUsage, BASE_ENTITY_VECTOR_SIZE))
+		{
+			// moved into a new array, as shrink_to_fit may keep the memory
+			auto shrunk = std::make_shared<Storage>(_components->get_allocator());
+			shrunk->reserve(std::max<std::size_t>(_components->size(), BASE_ENTITY_VECTOR_SIZE));
+			shrunk->insert(shrunk->end(), std::make_move_iterator(_components->begin()),
+			               std::make_move_iterator(_components->end()));
+			_components = std::move(shrunk);
+			ClearPadding();
+		}
 		
-		return _components->back();
+		ShrinkBuckets(*entityIndex, minUsage);
 	}
 	
-	void RemoveComponentFrom(EntityID id) override
+	void Unshare() override
 	{
-		RemoveComponent(id);
+		const std::lock_guard<std::mutex> lock(_unshareMutex);
+		if (!_isShared.load(std::memory_order_relaxed))
+			return;
+		
+		LeaveForkGroup([this]()
+		{
+			if (_components.use_count() > 1)
+			{
+				if constexpr (std::is_copy_constructible_v<ComponentType>)
+				{
+					auto copy = std::make_shared<Storage>(*_components);
+					for (ComponentType &component : *copy)
+					{
+						component.manager = manager;
+					}
+					_components = std::move(copy);
+				} else
+				{
+					assert(false && "Components that are not copyable can not be shared!");
+				}
+			}
+			
+			if (entityIndex.use_count() > 1)
+				entityIndex = std::make_shared<tsl::robin_map<EntityID, IndexType>>(*entityIndex);
+		});
+		
+		// the other ComponentVectors only read the components before they dropped them
+		std::atomic_thread_fence(std::memory_order_acquire);
+		_isShared.store(false, std::memory_order_release);
 	}
 	
-	void RemoveComponent(EntityID id)
+	void AdoptSharedComponents() override
 	{
-		if (!entityIndex->count(id))
+		if (_components->empty() || _components->front().manager == manager)
 			return;
 		
-		(*_components)[(*entityIndex)[id]] = _components->back();
-		(*entityIndex)[_components->back().id] = (*entityIndex)[id];
-		entityIndex->erase(id);
+		for (ComponentType &component : *_components)
+		{
+			component.manager = manager;
+		}
+	}
+	
+	void Clear() override
+	{
+		MarkLayoutChanged();
+		_components->clear();
+		entityIndex->clear();
+		_isEntityIndexStale.store(false, std::memory_order_release);
+	}
+	
+	/// Removes the component of id by moving the last component into its place
+	/// \return The EntityID whose component was moved or an invalid EntityID if no component was moved
+	EntityID RemoveComponent(EntityID id)
+	{
+		if (!Contains(id))
+			return EntityID();
+		
+		// copies the map if it is shared with a fork, so it is looked up afterwards
+		MarkLayoutChanged();
+		tsl::robin_map<EntityID, IndexType> &index = EntityIndex();
+		auto found = index.find(id);
+		const IndexType removedIndex = found->second;
+		const IndexType lastIndex = static_cast<IndexType>(_components->size() - 1);
+		index.erase(found);
+		
+		// fill the gap with the last component so the array stays dense
+		EntityID movedId;
+		if (removedIndex != lastIndex)
+		{
+			movedId = (*_components)[lastIndex].id;
+			index.find(movedId).value() = removedIndex;
+			Relocate(lastIndex, removedIndex);
+		}
+		
 		_components->pop_back();
+		ClearPadding();
+		return movedId;
 	}
 	
 	ComponentType *GetComponent(EntityID id)
@@ -104,7 +763,16 @@ public:
 		if (!Contains(id))
 			return nullptr;
 		
-		return &(*_components)[(*entityIndex)[id]];
+		MarkChanged();
+		return &(*_components)[EntityIndex()[id]];
+	}
+	
+	const ComponentType *GetComponent(EntityID id) const
+	{
+		if (!Contains(id))
+			return nullptr;
+		
+		return &(*_components)[IndexOf(id)];
 	}
 	
 	ComponentType &operator[](size_t index)
@@ -112,15 +780,28 @@ public:
 		return (*_components)[index];
 	}
 	
+	/// \return A pointer to the contiguous array of all components, ordered by their index. Writing components
+	/// through it or through operator[] requires MarkChanged.
+	ComponentType *Data()
+	{
+		return _components->data();
+	}
+	
+	/// \return Size() rounded up to a multiple of Lanes
+	[[nodiscard]] std::size_t PaddedSize() const
+	{
+		return PaddedCount<ComponentType>(_components->size());
+	}
+	
 	[[nodiscard]] bool Contains(EntityID id) const
 	{
-		return entityIndex->count(id) != 0;
+		return EntityIndex().count(id) != 0;
 	}
 	
 	[[nodiscard]] IndexType IndexOf(EntityID id) const
 	{
 		assert(Contains(id));
 		
-		return (*entityIndex)[id];
+		return EntityIndex()[id];
 	}
 };
@@ -2,91 +2,168 @@
 
 #include <vector>
 #include <limits>
+#include <numeric>
 #include <cassert>
 #include <functional>
+#include <future>
+#include <algorithm>
 #include "../libs/robin-map/include/tsl/robin_map.h"
 #include "TypeId.h"
 #include "ECSManager.h"
 #include "ComponentViewBase.h"
+#include "ComponentQuery.h"
 #include "Scene.h"
+#include "Span.h"
+#include "ParallelFor.h"
+#include "JobSystem.h"
+#include "Profiler.h"
 
 enum class UpdateType
 {
 	Automatic, Manual
 };
 
+/// Iterates over all entities holding every one of the ComponentTypes. ComponentTypes declared const are only
+/// read, which makes a const ComponentView a read-only query.
+/// Any number of iterations, also over other views and on other threads, may run at the same time as long as no
+/// entities or components are added or removed meanwhile; debug builds assert this. Functions given to an
+/// iteration may only write the non-const components of the entity they were called with.
 template<typename ...ComponentTypes>
-class ComponentView : public ComponentViewBase
+class ComponentView
 {
 public:
-	/// Register the system in the ECS Manager and gets all currently eligible entities
+	/// Gets the query of the ComponentTypes from the ECS Manager, which holds all currently eligible entities
 	explicit ComponentView(ECSManager &manager);
 	
-	/// Adds a ComponentView in the currently active scene
+	/// Adds a ComponentView in the active scene of the calling thread
 	ComponentView();
 	
-	/// Adds the id to the ComponentView if it owns all interesting components
-	/// \param type The ComponentId of the components type that was added
-	/// \param id The EntityID to which the component was added
-	void OnComponentAdded(ComponentId type, EntityID id) override;
-	
-	/// Removes the id to the ComponentView if it was registered and the ComponentId was interesting for the system
-	/// \param type The ComponentId of the components type that was added
-	/// \param id The EntityID from which the component was removed
-	void OnComponentRemoved(ComponentId type, EntityID id) override;
-	
 	/// Updates the ComponentView registered entities
 	void Update();
 	
 	/// Applies func for every component in the view. Using Lambdas for func is recommended
 	/// \param func lambdaFunction
-	void Foreach(std::function<void(ComponentTypes &...)> func);
+	void Foreach(std::function<void(ComponentTypes &...)> func) const;
 	
 	/// Applies func for every component in the view using all possible threads. Note that only functions that
 	/// only modify the current component are legal to use in parallel_foreach
 	/// \param func
-	void Parallel_foreach(std::function<void(ComponentTypes &...)> func, int minSize = 256);
+	/// \param minSize The minimum number of entities a single thread processes
+	void Parallel_foreach(std::function<void(ComponentTypes &...)> func, int minSize = 256) const;
+	
+	/// Schedules func for every component in the view on the thread pool once all dependencies are finished and
+	/// returns right away. The view must stay alive and its entities must not change until the returned job finished.
+	/// \param func
+	/// \param dependencies The jobs that need to finish before func is applied to any component
+	/// \param grainSize The minimum number of entities processed by a single job
+	/// \return A job that finishes once func was applied to all components
+	JobHandle ScheduleForeach(std::function<void(ComponentTypes &...)> func,
+	                          const std::vector<JobHandle> &dependencies = {}, std::size_t grainSize = 256) const;
+	
+	/// Applies func to blocks of components that lie next to each other in every ComponentVector, which allows
+	/// func to process them with its own (vectorized) loop. Chunks ending at the end of a ComponentVector may be
+	/// processed up to ComponentVector::PaddedSize().
+	/// \tparam Func void(Span<ComponentTypes>... components, std::size_t count), where components[i] of every
+	/// span belong to the same entity
+	/// \param func
+	template<typename Func>
+	void ForeachChunk(Func func) const;
 	
-	std::size_t Size();
+	/// Applies ForeachChunk using all possible threads. Note that func may only modify the components of the
+	/// chunk it was given
+	/// \tparam Func void(Span<ComponentTypes>... components, std::size_t count)
+	/// \param func
+	/// \param minSize The minimum number of entities a single thread processes
+	template<typename Func>
+	void ParallelForeachChunk(Func func, std::size_t minSize = 256) const;
+	
+	/// Maps every entity of the view to a value and combines all values using all possible threads.
+	/// The entities are sorted by their EntityIDs and split into blocks of blockSize that are reduced in order, the
+	/// block results are then combined in a fixed pairwise tree. The result therefore only depends on the entities,
+	/// their components and blockSize, not on the number of threads or the order of the view, which differs after
+	/// it was rebuilt, e.g. by RestoreState. This makes it reproducible even for floating point values.
+	/// \tparam R The type of the result
+	/// \tparam Map R(const ComponentTypes &...)
+	/// \tparam Combine R(const R &, const R &), which needs to be associative
+	/// \param init The identity of combine, which every block starts with
+	/// \param map
+	/// \param combine
+	/// \param blockSize The number of entities reduced in order by a single thread
+	/// \return init if the view is empty
+	template<typename R, typename Map, typename Combine>
+	R ParallelReduce(R init, Map map, Combine combine, std::size_t blockSize = 1024) const;
+	
+	std::size_t Size() const;
 
 protected:
-	/// Checks if this ComponentView is interested in the given ComponentID meaning
-	/// whether or not it uses this componentType
-	/// \param type
-	/// \return
-	bool IsInterested(ComponentId type);
-	
-	
-	/// Puts the parameters into func
-	/// \tparam Is List of Integers deducted from seq
-	/// \param func The function the parameters shall be applied
-	/// \param ComponentVectors The componentVectors containing the ComponentTypes
-	/// \param startIndex The index where the componentIndex list of the current entity begins
-	/// \param seq  The integer sequence with length equal to sizeOf...(ComponentTypes)
-	template<size_t... Is>
-	constexpr inline void ApplyFunction(const std::function<void(ComponentTypes &...)> &func,
-	                                    const std::tuple<ComponentVector<ComponentTypes> &...> &ComponentVectors,
-	                                    IndexType startIndex,
-	                                    const std::index_sequence<Is...> seq) const
+	/// References to the ComponentVectors of all ComponentTypes
+	using ComponentVectors = std::tuple<ComponentVector<std::remove_const_t<ComponentTypes>> &...>;
+	
+	/// \return Whether the manager holds a ComponentVector for every ComponentType
+	[[nodiscard]] bool HasComponentVectors() const
+	{
+		return (_manager.GetComponents<std::remove_const_t<ComponentTypes>>() && ...);
+	}
+	
+	/// Requires HasComponentVectors()
+	[[nodiscard]] ComponentVectors GetComponentVectors() const
+	{
+		return ComponentVectors{*_manager.GetComponents<std::remove_const_t<ComponentTypes>>()...};
+	}
+	
+	/// Requires HasComponentVectors(). Marks the ComponentVectors of the non-const ComponentTypes as changed for
+	/// ECSManager::SaveState, as functions given to an iteration may write them.
+	void MarkWritten() const
+	{
+		((std::is_const_v<ComponentTypes>
+		  ? void()
+		  : _manager.GetComponents<std::remove_const_t<ComponentTypes>>()->MarkChanged()), ...);
+	}
+	
+	/// \return The ComponentTypes of the view, which detail the profiling zones of its iterations
+	static const char *ProfileDetail()
 	{
-		func((std::get<Is>(ComponentVectors)[(*_vectoredEntities)[startIndex + Is]])...);
+		static const std::string detail = []()
+		{
+			std::string types;
+			((types += (types.empty() ? "" : ", ") + std::string(std::is_const_v<ComponentTypes> ? "const " : "") +
+			           ComponentSerializer<std::remove_const_t<ComponentTypes>>::Name()), ...);
+			return types;
+		}();
+		return detail.c_str();
+	}
+	
+	/// Calls func with the components of the entity at the given position of the view
+	/// \return The result of func
+	template<typename Func, size_t... Is>
+	decltype(auto) InvokeAt(Func &func, const ComponentVectors &componentVectors,
+	                        std::size_t position, std::index_sequence<Is...>) const
+	{
+		constexpr std::size_t nTypes = sizeof...(ComponentTypes);
+		return func(std::get<Is>(componentVectors)[(*_vectoredEntities)[position * nTypes + Is]]...);
 	}
+	
+	/// The number of positions ForeachChunk iterates over. For a single ComponentType every component of its
+	/// ComponentVector is part of the view and positions are the indices of the ComponentVector
+	std::size_t ChunkPositions() const;
+	
+	/// Calls func for every chunk between the positions begin and end
+	template<typename Func, size_t... Is>
+	void ForeachChunkIn(Func &func, std::size_t begin, std::size_t end, std::index_sequence<Is...> seq) const;
+	
+	/// \return Whether the components of the entity at position + 1 directly follow the ones at position
+	[[nodiscard]] bool IsContiguous(std::size_t position) const;
 
 protected:
 	UpdateType _currUpdateMode{UpdateType::Automatic}; // TODO: Implement function to change the way views are updated
 	
 	ECSManager &_manager;
 	
-	/// The ComponentIds of the types the ComponentView is interested in
-	std::vector<ComponentId> _operatingTypes;
-	
-	/// Maps EntityID to the indices of its components in the respective ComponentVectors
-	std::unique_ptr<tsl::robin_map<EntityID, IndexType>> _registeredEntities{};
+	/// The entity list shared with all other ComponentViews of the same ComponentTypes
+	std::shared_ptr<ComponentQuery<std::remove_const_t<ComponentTypes>...>> _query;
 	
-	// saves the indices of the components of an entity behind next to each other
-	std::unique_ptr<std::vector<IndexType> > _vectoredEntities{};
-	
-	mutable std::condition_variable suspendCV{};
+	// saves the indices of the components of an entity behind next to each other, owned by _query
+	std::vector<IndexType> *_vectoredEntities;
 };
 
 
@@ -101,227 +178,273 @@ ComponentView<ComponentTypes...>::ComponentView()
 template<typename... ComponentTypes>
 ComponentView<ComponentTypes...>::ComponentView(ECSManager &manager)
 		:_manager(manager)
+		 , _query(ComponentQuery<std::remove_const_t<ComponentTypes>...>::Acquire(manager))
+		 , _vectoredEntities(_query->_vectoredEntities.get())
 {
-	_operatingTypes = {TypeId<ComponentTypes>::GetId()...};
-	
-	_vectoredEntities = std::make_unique<std::vector<IndexType>>();
-	_vectoredEntities->reserve(16);
-	
-	_registeredEntities = std::make_unique<tsl::robin_map<EntityID, IndexType>>();
-	
-	// register in entity system with types
-	_manager.RegisterComponentSystem(this, _operatingTypes);
-	
-	// fill registeredEntities
-	Update();
 }
 
+
 template<typename... ComponentTypes>
-void ComponentView<ComponentTypes...>::OnComponentAdded(ComponentId type, EntityID id)
+void ComponentView<ComponentTypes...>::Foreach(const std::function<void(ComponentTypes &...)> func) const
 {
-	if (!IsInterested(type))
-		return;
+	PANCAKE_PROFILE_ZONE("ComponentView::Foreach", ProfileDetail());
 	
-	// Check if all ComponentArrays of the interesting ComponentTypes have the Entity registered
-	if (!((_manager.GetComponents<ComponentTypes>() &&
-	       _manager.GetComponents<ComponentTypes>()->Contains(id)) && ...))
-	{
+	if (!HasComponentVectors())
 		return;
-	}
 	
-	// component should not already be registered in registeredEntities as it had a missing component
-	if (_registeredEntities->count(id))
-		return;
+	IterationScope iteration(_manager);
+	MarkWritten();
+	PANCAKE_PROFILE_COUNTERS("ComponentView::Foreach", ProfileDetail(), _query->Size());
+	
+	// the componentVectors the iterate over
+	ComponentVectors compVectors = GetComponentVectors();
 	
 	
-	_registeredEntities->insert(std::pair(id, _vectoredEntities->size() - 1));
-	( _vectoredEntities->push_back(_manager.GetComponents<ComponentTypes>()->IndexOf(id)), ...);
+	constexpr auto seq = std::make_index_sequence<sizeof...(ComponentTypes)>();
+	for (std::size_t position = 0; position < _query->Size(); ++position)
+	{
+		InvokeAt(func, compVectors, position, seq);
+	}
 }
 
 template<typename... ComponentTypes>
-void ComponentView<ComponentTypes...>::OnComponentRemoved(ComponentId type, EntityID id)
+void
+ComponentView<ComponentTypes...>::Parallel_foreach(std::function<void(ComponentTypes &...)> func,
+                                                   const int minSize) const
 {
-	if (!IsInterested(type))
-		return;
+	PANCAKE_PROFILE_ZONE("ComponentView::Parallel_foreach", ProfileDetail());
 	
-	// check if the id is registered in the system
-	if (!_registeredEntities->count(id))
+	if (!HasComponentVectors())
 		return;
 	
+	IterationScope iteration(_manager);
+	MarkWritten();
+	
+	ComponentVectors compVectors = GetComponentVectors();
+	
+	// views with less than two times minSize entities are processed on the calling thread only
+	ParallelFor(_manager.ThreadPool(), _query->Size(), static_cast<std::size_t>(std::max(minSize, 1)),
+	            [&](std::size_t begin, std::size_t end)
+	            {
+		            PANCAKE_PROFILE_ZONE("ComponentView::Parallel_foreach slice", ProfileDetail());
+		            
+		            constexpr auto seq = std::make_index_sequence<sizeof...(ComponentTypes)>();
+		            for (std::size_t position = begin; position < end; ++position)
+		            {
+			            InvokeAt(func, compVectors, position, seq);
+		            }
+	            });
+}
+
+template<typename... ComponentTypes>
+JobHandle ComponentView<ComponentTypes...>::ScheduleForeach(std::function<void(ComponentTypes &...)> func,
+                                                            const std::vector<JobHandle> &dependencies,
+                                                            std::size_t grainSize) const
+{
+	ctpl::thread_pool &pool = _manager.ThreadPool();
+	auto sharedFunc = std::make_shared<std::function<void(ComponentTypes &...)>>(std::move(func));
 	
-	IndexType componentVectorIndex = (*_registeredEntities)[id];
-	
+	// the number of jobs is fixed now, their ranges are computed once the dependencies are done
+	const std::size_t nJobs = std::clamp<std::size_t>(_query->Size() / std::max<std::size_t>(grainSize, 1), 1,
+	                                                  std::max(pool.size(), 1));
 	
-	if (componentVectorIndex ==
-	    _vectoredEntities->size() - (1 + sizeof...(ComponentTypes))) // special case when we remove the last thing
+	std::vector<JobHandle> rangeJobs;
+	rangeJobs.reserve(nJobs);
+	for (std::size_t j = 0; j < nJobs; ++j)
 	{
-		for (int j = 0; j < sizeof...(ComponentTypes); ++j)
+		rangeJobs.push_back(ScheduleJob(pool, [this, sharedFunc, nJobs, j]()
 		{
-			_vectoredEntities->pop_back();
-		}
-	} else
+			PANCAKE_PROFILE_ZONE("ComponentView::ScheduleForeach job", ProfileDetail());
+			
+			if (!HasComponentVectors())
+				return;
+			
+			IterationScope iteration(_manager);
+			MarkWritten();
+			
+			ComponentVectors compVectors = GetComponentVectors();
+			constexpr auto seq = std::make_index_sequence<sizeof...(ComponentTypes)>();
+			
+			const std::size_t end = RangeBegin(_query->Size(), nJobs, j + 1);
+			for (std::size_t position = RangeBegin(_query->Size(), nJobs, j); position < end; ++position)
+			{
+				InvokeAt(*sharedFunc, compVectors, position, seq);
+			}
+		}, dependencies));
+	}
+	
+	if (nJobs == 1)
+		return rangeJobs[0];
+	
+	// join the range jobs and pass on their exceptions
+	return ScheduleJob(pool, [rangeJobs]()
 	{
-		// swap last and to be deleted position
-		const std::size_t startIndex = _vectoredEntities->size() - (1 + sizeof...(ComponentTypes));
-		const std::size_t endIndex = _vectoredEntities->size() - 1;
-		for (std::size_t i = startIndex; i < endIndex; ++i)
+		for (const JobHandle &rangeJob : rangeJobs)
 		{
-			(*_vectoredEntities)[i - sizeof...(ComponentTypes)] = (*_vectoredEntities)[i];
+			rangeJob.Wait();
 		}
-		
-		// remove last component indices
-		for (int j = 0; j < sizeof...(ComponentTypes); ++j)
-		{
-			_vectoredEntities->pop_back();
-		}
-	}
-	
-	_registeredEntities->erase(id);
+	}, rangeJobs);
 }
 
 template<typename... ComponentTypes>
-bool ComponentView<ComponentTypes...>::IsInterested(ComponentId type)
+template<typename Func>
+void ComponentView<ComponentTypes...>::ForeachChunk(Func func) const
 {
-	for (ComponentId currType : _operatingTypes)
-	{
-		if (currType == type)
-			return true;
-	}
-	return false;
+	PANCAKE_PROFILE_ZONE("ComponentView::ForeachChunk", ProfileDetail());
+	
+	if (!HasComponentVectors())
+		return;
+	
+	IterationScope iteration(_manager);
+	MarkWritten();
+	
+	ForeachChunkIn(func, 0, ChunkPositions(), std::make_index_sequence<sizeof...(ComponentTypes)>());
 }
 
-
 template<typename... ComponentTypes>
-void ComponentView<ComponentTypes...>::Foreach(const std::function<void(ComponentTypes &...)> func)
+template<typename Func>
+void ComponentView<ComponentTypes...>::ParallelForeachChunk(Func func, std::size_t minSize) const
 {
+	PANCAKE_PROFILE_ZONE("ComponentView::ParallelForeachChunk", ProfileDetail());
 	
-	// the componentVectors the iterate over
-	std::tuple<ComponentVector<ComponentTypes> &...> compVectors{*_manager.GetComponents<ComponentTypes>()...};
+	if (!HasComponentVectors())
+		return;
 	
+	IterationScope iteration(_manager);
+	MarkWritten();
 	
 	constexpr auto seq = std::make_index_sequence<sizeof...(ComponentTypes)>();
-	for (std::size_t i = 0; i < _vectoredEntities->size() / sizeof...(ComponentTypes); i += sizeof...(ComponentTypes))
+	ParallelFor(_manager.ThreadPool(), ChunkPositions(), minSize, [&](std::size_t begin, std::size_t end)
 	{
-		ApplyFunction(func, compVectors, i, seq);
-	}
+		PANCAKE_PROFILE_ZONE("ComponentView::ParallelForeachChunk slice", ProfileDetail());
+		
+		ForeachChunkIn(func, begin, end, seq);
+	});
 }
 
 template<typename... ComponentTypes>
-void
-ComponentView<ComponentTypes...>::Parallel_foreach(std::function<void(ComponentTypes &...)> func, const int minSize)
+template<typename R, typename Map, typename Combine>
+R ComponentView<ComponentTypes...>::ParallelReduce(R init, Map map, Combine combine, std::size_t blockSize) const
 {
-	// check if it actually makes sense to use parallel execution, depending on the input size
-	size_t vectorSize = _vectoredEntities->size() / sizeof...(ComponentTypes);
+	assert(blockSize > 0);
+	PANCAKE_PROFILE_ZONE("ComponentView::ParallelReduce", ProfileDetail());
 	
-	if (vectorSize < minSize)
-	{
-		// use single core implementation
-		Foreach(func);
-		return;
-	}
+	if (!HasComponentVectors())
+		return init;
 	
-	// use multi threaded implementation
-	int nThreads = static_cast<int>(std::thread::hardware_concurrency());
-	std::atomic_int nDone = 0;
+	IterationScope iteration(_manager);
 	
-	std::mutex mutex;
-	std::unique_lock<std::mutex> lock(mutex);
+	const std::size_t nEntities = _query->Size();
+	const std::size_t nBlocks = (nEntities + blockSize - 1) / blockSize;
+	if (nBlocks == 0)
+		return init;
 	
+	// the positions of the view depend on the order the entities were added and removed in, their ids do not
+	const std::vector<EntityID> &viewedEntities = *_query->_viewedEntities;
+	std::vector<IndexType> order(nEntities);
+	std::iota(order.begin(), order.end(), IndexType(0));
+	std::sort(order.begin(), order.end(), [&viewedEntities](IndexType lhs, IndexType rhs)
+	{
+		return viewedEntities[lhs].Index() < viewedEntities[rhs].Index();
+	});
+	
+	ComponentVectors compVectors = GetComponentVectors();
+	std::vector<R> partials(nBlocks, init);
 	
-	std::tuple<ComponentVector<ComponentTypes> &...> compVectors{*_manager.GetComponents<ComponentTypes>()...};
-	for (int j = 0; j < nThreads; ++j)
+	// threads get blocks in any order, but every block is always reduced the same way
+	ParallelFor(_manager.ThreadPool(), nBlocks, 1, [&](std::size_t beginBlock, std::size_t endBlock)
 	{
-		std::size_t start = j * (vectorSize / nThreads);
-		std::size_t end = std::min((j + 1) * (vectorSize / nThreads), vectorSize);
+		PANCAKE_PROFILE_ZONE("ComponentView::ParallelReduce slice", ProfileDetail());
 		
-		tPool.push([&](int id)
-		           {
-			           constexpr auto seq = std::make_index_sequence<sizeof...(ComponentTypes)>();
-			           for (std::size_t i = start; i < end; ++i)
-			           {
-				           ApplyFunction(func, compVectors, i, seq);
-			           }
-			
-			
-			           nDone++;
-			           suspendCV.notify_one();
-		           });
+		constexpr auto seq = std::make_index_sequence<sizeof...(ComponentTypes)>();
+		for (std::size_t block = beginBlock; block < endBlock; ++block)
+		{
+			const std::size_t end = std::min((block + 1) * blockSize, nEntities);
+			R partial = init;
+			for (std::size_t i = block * blockSize; i < end; ++i)
+			{
+				partial = combine(partial, InvokeAt(map, compVectors, order[i], seq));
+			}
+			partials[block] = std::move(partial);
+		}
+	});
+	
+	// combine neighbouring partials until a single one is left
+	for (std::size_t stride = 1; stride < nBlocks; stride *= 2)
+	{
+		for (std::size_t i = 0; i + stride < nBlocks; i += 2 * stride)
+		{
+			partials[i] = combine(partials[i], partials[i + stride]);
+		}
 	}
 	
-	suspendCV.wait(lock, [&]() { return nDone == nThreads; });
+	return partials[0];
 }
 
-
 template<typename... ComponentTypes>
-size_t ComponentView<ComponentTypes...>::Size()
+std::size_t ComponentView<ComponentTypes...>::ChunkPositions() const
 {
-	return _registeredEntities->size();
+	if constexpr (sizeof...(ComponentTypes) == 1)
+		return std::get<0>(GetComponentVectors()).Size();
+	else
+		return _query->Size();
 }
 
 template<typename... ComponentTypes>
-void ComponentView<ComponentTypes...>::Update()
+template<typename Func, size_t... Is>
+void ComponentView<ComponentTypes...>::ForeachChunkIn(Func &func, std::size_t begin, std::size_t end,
+                                                      std::index_sequence<Is...>) const
 {
-	// init data structures
-	_vectoredEntities->clear();
-	_vectoredEntities->reserve(16);
-	
-	_registeredEntities->clear();
+	ComponentVectors compVectors = GetComponentVectors();
 	
+	if constexpr (sizeof...(ComponentTypes) == 1)
+	{
+		// the whole range is a single chunk
+		if (begin < end)
+			func(Span<ComponentTypes>(std::get<Is>(compVectors).Data() + begin, end - begin)..., end - begin);
+		return;
+	}
 	
-	// look for already registered components in the system
-	if ((_manager.GetComponents<ComponentTypes>() && ...))
+	constexpr std::size_t nTypes = sizeof...(ComponentTypes);
+	std::size_t chunkBegin = begin;
+	while (chunkBegin < end)
 	{
-		std::vector<ComponentVectorBase *> interestingComponents = std::vector<ComponentVectorBase *>();
-		interestingComponents.reserve(_operatingTypes.size());
-		
-		
-		for (ComponentId currId : _operatingTypes)
+		std::size_t chunkEnd = chunkBegin + 1;
+		while (chunkEnd < end && IsContiguous(chunkEnd - 1))
 		{
-			interestingComponents.push_back(_manager.GetComponentsBase(currId));
+			++chunkEnd;
 		}
 		
-		// check if the components ids of the first componentVector are also registered in the other componentVectors
-		// if yes, add them to the registered entities
-		ComponentVectorBase *startComponents = interestingComponents[0];
+		const std::size_t count = chunkEnd - chunkBegin;
+		func(Span<ComponentTypes>(std::get<Is>(compVectors).Data() + (*_vectoredEntities)[chunkBegin * nTypes + Is],
+		                          count)..., count);
 		
-		// search for smallest component vector to minimize work
-		for (ComponentVectorBase *currComponents : interestingComponents)
-		{
-			if (currComponents->Size() < startComponents->Size())
-			{
-				startComponents = currComponents;
-			}
-		}
-		
-		for (const auto &currPair : startComponents->getEntities())
-		{
-			std::vector<IndexType> componentIndices = std::vector<IndexType>();
-			componentIndices.reserve(_operatingTypes.size());
-			
-			// look for components belonging to the id in currPair in the other componentVectors
-			bool isRegisteredEverywhere = true;
-			for (ComponentVectorBase *currComponents : interestingComponents)
-			{
-				if (!currComponents->getEntities().count(currPair.first))
-				{
-					isRegisteredEverywhere = false;
-					break;
-				}
-				
-				// add components index to componentIndices
-				componentIndices.push_back(currComponents->getEntities().at(currPair.first));
-			}
-			
-			if (!isRegisteredEverywhere)
-				continue;
-			
-			// register this id with componentIndices
-			for (IndexType currIndex : componentIndices)
-			{
-				_vectoredEntities->push_back(currIndex);
-			}
-			
-			_registeredEntities->insert(std::pair(currPair.first, _vectoredEntities->size() - 1));
-		}
+		chunkBegin = chunkEnd;
+	}
+}
+
+template<typename... ComponentTypes>
+bool ComponentView<ComponentTypes...>::IsContiguous(std::size_t position) const
+{
+	constexpr std::size_t nTypes = sizeof...(ComponentTypes);
+	for (std::size_t i = 0; i < nTypes; ++i)
+	{
+		if ((*_vectoredEntities)[position * nTypes + i] + 1 != (*_vectoredEntities)[(position + 1) * nTypes + i])
+			return false;
 	}
-}
\ No newline at end of file
+	return true;
+}
+
+
+template<typename... ComponentTypes>
+size_t ComponentView<ComponentTypes...>::Size() const
+{
+	return _query->Size();
+}
+
+template<typename... ComponentTypes>
+void ComponentView<ComponentTypes...>::Update()
+{
+	PANCAKE_PROFILE_ZONE("ComponentView::Update", ProfileDetail());
+	_query->Update();
+}
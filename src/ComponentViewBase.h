@@ -1,26 +1,94 @@
 #pragma once
 
 
+#include <vector>
+#include <utility>
 #include "ctpl_stl.h"
+#include "ThreadAffinity.h"
 #include "TypeId.h"
 #include "EntityID.h"
+#include "MemoryStats.h"
 
 class ComponentViewBase
 {
 public:
-	/// Executed when a component with the ComponentID type for the EntityID id is added.
-	/// Registers the given component in the system, if the id owns all the necessary components for the system.
+	virtual ~ComponentViewBase() = default;
+	
+	/// Executed when a component with the ComponentID type is added and the EntityID id owns all
+	/// components of the system afterwards.
 	/// \param type
 	/// \param id
 	virtual void OnComponentAdded(ComponentId type, EntityID id) = 0;
 	
-	/// Executed when a component with the ComponentID type for the EntityID id is removed.
-	/// Unregisters the given component from the system if it was registered.
+	/// Executed when a component with the ComponentID type is removed from the EntityID id while it owned all
+	/// components of the system.
 	/// \param type
 	/// \param id
 	virtual void OnComponentRemoved(ComponentId type, EntityID id) = 0;
+	
+	/// Executed when the component with the ComponentID type of a registered EntityID id was moved to another index
+	/// of its ComponentVector.
+	/// \param type
+	/// \param id
+	/// \param newIndex The index of the component in its ComponentVector
+	virtual void OnComponentMoved(ComponentId type, EntityID id, IndexType newIndex) = 0;
+	
+	/// Rebuilds the entities of the system from the ComponentVectors of its manager
+	virtual void Update() = 0;
+	
+	/// \return The memory held by the entity lists of the system
+	[[nodiscard]] virtual QueryMemoryStats GetMemoryStats() const = 0;
+	
+	/// Gives back the memory of the entity lists of the system if they use less than minUsage of it
+	virtual void ShrinkToFit(float minUsage) = 0;
+	
+	/// \return The set of ComponentIds an entity needs to own to be part of the system
+	[[nodiscard]] const ComponentMask &QueryMask() const
+	{
+		return _queryMask;
+	}
+	
+	/// \return The thread pool used by the parallel methods of the ComponentViews of all ECSManagers without their own
+	/// pool. It is only started when it is used first.
+	static ctpl::thread_pool &ThreadPool()
+	{
+		static ctpl::thread_pool pool(static_cast<int>(std::thread::hardware_concurrency()));
+		return pool;
+	}
+	
+	/// Resizes the shared thread pool and pins its workers. Must not be called while the pool works on jobs.
+	/// \return Whether every worker that should be pinned was pinned
+	static bool ConfigureThreadPool(const ThreadPoolConfig &config)
+	{
+		return ::ConfigureThreadPool(ThreadPool(), config);
+	}
+	
+	/// \return Whether the system is registered in an ECSManager that is still alive
+	[[nodiscard]] bool IsRegistered() const
+	{
+		return !_registrySlots.empty();
+	}
 
 protected:
-	/// The thread pool that is used for the Parallel_Foreach method
-	inline static ctpl::thread_pool tPool = ctpl::thread_pool(static_cast<int>(std::thread::hardware_concurrency()));
+	friend class ECSManager;
+	
+	template<typename ...>
+	friend
+	class ComponentView;
+	
+	/// The set of ComponentIds an entity needs to own to be part of the system
+	ComponentMask _queryMask{};
+	
+	/// The position of the system in the list of systems of every ComponentId it is registered for,
+	/// which allows the ECSManager to unregister it without searching the lists
+	std::vector<std::pair<ComponentId, std::size_t> > _registrySlots{};
+	
+	void SetRegistrySlot(ComponentId type, std::size_t slot)
+	{
+		for (auto &registrySlot : _registrySlots)
+		{
+			if (registrySlot.first == type)
+				registrySlot.second = slot;
+		}
+	}
 };
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include <cstring>
+#include <algorithm>
+#include "DeltaSnapshot.h"
+#include "ECSManager.h"
+
+namespace
+{
+	/// Zero runs shorter than this are cheaper to store as part of the surrounding changed bytes
+	constexpr std::size_t MIN_ZERO_RUN = 3;
+	
+	void WriteVarint(SnapshotWriter &writer, std::uint64_t value)
+	{
+		std::uint8_t bytes[10];
+		std::size_t size = 0;
+		do
+		{
+			bytes[size] = static_cast<std::uint8_t>(value & 0x7F);
+			value >>= 7;
+			if (value != 0)
+				bytes[size] |= 0x80;
+			++size;
+		} while (value != 0);
+		
+		writer.Write(bytes, size);
+	}
+	
+	bool ReadVarint(SnapshotReader &reader, std::uint64_t &value)
+	{
+		value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7)
+		{
+			const auto byte = reader.ReadValue<std::uint8_t>();
+			if (reader.Failed())
+				return false;
+			
+			value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+	
+	/// \return The byte i of current XOR base, where base is treated as zero behind its end
+	inline char XorAt(Span<const char> base, Span<const char> current, std::size_t i)
+	{
+		return static_cast<char>(current[i] ^ (i < base.Size() ? base[i] : 0));
+	}
+	
+	/// \return The first index from begin on whose XOR is not zero
+	std::size_t SkipUnchanged(Span<const char> base, Span<const char> current, std::size_t begin)
+	{
+		// compare whole words while both sides have bytes
+		const std::size_t common = std::min(base.Size(), current.Size());
+		std::size_t i = begin;
+		while (i + sizeof(std::uint64_t) <= common)
+		{
+			std::uint64_t baseWord, currentWord;
+			std::memcpy(&baseWord, base.Data() + i, sizeof(baseWord));
+			std::memcpy(&currentWord, current.Data() + i, sizeof(currentWord));
+			if (baseWord != currentWord)
+				break;
+			i += sizeof(std::uint64_t);
+		}
+		
+		while (i < current.Size() && XorAt(base, current, i) == 0)
+		{
+			++i;
+		}
+		return i;
+	}
+	
+	/// Writes current as runs of unchanged bytes followed by the XOR of the changed bytes
+	void WriteXorRuns(Span<const char> base, Span<const char> current, SnapshotWriter &writer)
+	{
+		std::vector<char> changed;
+		std::size_t i = 0;
+		while (i < current.Size())
+		{
+			const std::size_t changeBegin = SkipUnchanged(base, current, i);
+			
+			// extend the change until a run of unchanged bytes that is long enough to be worth its own run
+			std::size_t changeEnd = changeBegin;
+			while (changeEnd < current.Size())
+			{
+				const std::size_t nextChange = SkipUnchanged(base, current, changeEnd);
+				if (nextChange - changeEnd >= MIN_ZERO_RUN || nextChange == current.Size())
+					break;
+				
+				changeEnd = nextChange;
+				while (changeEnd < current.Size() && XorAt(base, current, changeEnd) != 0)
+				{
+					++changeEnd;
+				}
+			}
+			
+			changed.resize(changeEnd - changeBegin);
+			for (std::size_t j = changeBegin; j < changeEnd; ++j)
+			{
+				changed[j - changeBegin] = XorAt(base, current, j);
+			}
+			
+			WriteVarint(writer, changeBegin - i);
+			WriteVarint(writer, changed.size());
+			writer.Write(changed.data(), changed.size());
+			i = changeEnd;
+		}
+	}
+	
+	/// Reconstructs size bytes written by WriteXorRuns against base into current
+	bool ReadXorRuns(Span<const char> base, std::size_t size, SnapshotReader &reader, std::vector<char> &current)
+	{
+		current.assign(size, 0);
+		if (!base.Empty())
+			std::memcpy(current.data(), base.Data(), std::min(base.Size(), size));
+		
+		std::size_t i = 0;
+		while (i < size)
+		{
+			std::uint64_t unchanged, nChanged;
+			if (!ReadVarint(reader, unchanged) || !ReadVarint(reader, nChanged) ||
+			    unchanged > size - i || nChanged > size - i - unchanged || unchanged + nChanged == 0)
+				return false;
+			
+			i += unchanged;
+			const char *changed = reader.Borrow(nChanged);
+			if (!changed)
+				return false;
+			
+			for (std::size_t j = 0; j < nChanged; ++j)
+			{
+				current[i + j] = static_cast<char>(current[i + j] ^ changed[j]);
+			}
+			i += nChanged;
+		}
+		return true;
+	}
+	
+	/// \return The section with the given name or nullptr if there is none
+	const SnapshotSection *FindSection(const SnapshotSections &sections, const std::string &name)
+	{
+		for (const SnapshotSection &section : sections)
+		{
+			if (section.name == name)
+				return &section;
+		}
+		return nullptr;
+	}
+	
+	/// \return The array with the given index of section, the bytes between two boundaries, or an empty span if the
+	/// section is nullptr or has fewer arrays
+	Span<const char> ArrayOf(const SnapshotSection *section, std::size_t index)
+	{
+		if (!section || index > section->boundaries.size())
+			return Span<const char>();
+		
+		const std::size_t begin = index == 0 ? 0 : section->boundaries[index - 1];
+		const std::size_t end = index == section->boundaries.size() ? section->bytes.size() : section->boundaries[index];
+		return Span<const char>(section->bytes.data() + begin, end - begin);
+	}
+	
+	/// Writes the arrays of current relative to the arrays of base with the same index
+	void WriteSection(const SnapshotSection *base, const SnapshotSection &current, SnapshotWriter &writer)
+	{
+		writer.WriteString(current.name);
+		WriteVarint(writer, current.boundaries.size() + 1);
+		for (std::size_t i = 0; i <= current.boundaries.size(); ++i)
+		{
+			const Span<const char> array = ArrayOf(&current, i);
+			WriteVarint(writer, array.Size());
+			WriteXorRuns(ArrayOf(base, i), array, writer);
+		}
+	}
+	
+	/// Reconstructs a section written by WriteSection, looking up its base by name in previous
+	bool ReadSection(const SnapshotSections &previous, SnapshotReader &reader, SnapshotSection &current)
+	{
+		std::uint64_t nArrays;
+		if (!reader.ReadString(current.name) || !ReadVarint(reader, nArrays) || nArrays == 0)
+			return false;
+		
+		const SnapshotSection *base = FindSection(previous, current.name);
+		std::vector<char> array;
+		for (std::uint64_t i = 0; i < nArrays; ++i)
+		{
+			std::uint64_t size;
+			if (!ReadVarint(reader, size) || !ReadXorRuns(ArrayOf(base, i), size, reader, array))
+				return false;
+			
+			if (i != 0)
+				current.boundaries.push_back(current.bytes.size());
+			current.bytes.insert(current.bytes.end(), array.begin(), array.end());
+		}
+		return true;
+	}
+}
+
+void DeltaEncoder::Encode(const ECSManager &manager, std::vector<char> &delta)
+{
+	const std::vector<std::pair<ComponentId, ComponentVectorBase *>> componentVectors = manager.SortedComponentVectors();
+	
+	// reuse the buffers of the state before the previous one
+	_current.resize(componentVectors.size() + 1);
+	for (SnapshotSection &section : _current)
+	{
+		section.bytes.clear();
+		section.boundaries.clear();
+	}
+	
+	_current[0].name.clear();
+	MemorySnapshotWriter entityWriter(_current[0].bytes);
+	entityWriter.RecordBoundaries(&_current[0].boundaries);
+	manager.WriteEntitySnapshot(entityWriter);
+	
+	for (std::size_t i = 0; i < componentVectors.size(); ++i)
+	{
+		SnapshotSection &section = _current[i + 1];
+		section.name = componentVectors[i].second->SnapshotName();
+		MemorySnapshotWriter componentWriter(section.bytes);
+		componentWriter.RecordBoundaries(&section.boundaries);
+		componentVectors[i].second->WriteSnapshot(componentWriter);
+	}
+	
+	MemorySnapshotWriter writer(delta);
+	writer.WriteValue(DELTA_MAGIC);
+	writer.WriteValue(SNAPSHOT_VERSION);
+	writer.WriteValue(_sequence);
+	writer.WriteValue(static_cast<std::uint32_t>(_current.size()));
+	for (const SnapshotSection &section : _current)
+	{
+		WriteSection(FindSection(_previous, section.name), section, writer);
+	}
+	
+	std::swap(_previous, _current);
+	++_sequence;
+}
+
+void DeltaEncoder::Reset()
+{
+	_previous.clear();
+	_sequence = 0;
+}
+
+bool DeltaDecoder::Apply(ECSManager &manager, Span<const char> delta)
+{
+	MemorySnapshotReader reader(delta);
+	const auto magic = reader.ReadValue<std::uint32_t>();
+	const auto version = reader.ReadValue<std::uint32_t>();
+	const auto sequence = reader.ReadValue<std::uint64_t>();
+	const auto nSections = reader.ReadValue<std::uint32_t>();
+	if (reader.Failed() || magic != DELTA_MAGIC || version != SNAPSHOT_VERSION ||
+	    (sequence != 0 && sequence != _sequence) || nSections == 0 || nSections > MAX_COMPONENT_TYPES + 1)
+		return false;
+	
+	// a delta with sequence 0 holds the whole state and does not depend on anything applied before
+	const SnapshotSections emptySections;
+	const SnapshotSections &previous = sequence == 0 ? emptySections : _previous;
+	
+	SnapshotSections current(nSections);
+	for (SnapshotSection &section : current)
+	{
+		if (!ReadSection(previous, reader, section))
+			return false;
+	}
+	
+	// put the sections together to a snapshot as ECSManager::SaveSnapshot writes it
+	std::vector<char> snapshot;
+	MemorySnapshotWriter writer(snapshot);
+	writer.WriteValue(SNAPSHOT_MAGIC);
+	writer.WriteValue(SNAPSHOT_VERSION);
+	writer.Write(current[0].bytes.data(), current[0].bytes.size());
+	writer.WriteValue(static_cast<std::uint32_t>(current.size() - 1));
+	for (std::size_t i = 1; i < current.size(); ++i)
+	{
+		writer.WriteString(current[i].name);
+		writer.Align(SNAPSHOT_ARRAY_ALIGNMENT);
+		writer.Write(current[i].bytes.data(), current[i].bytes.size());
+	}
+	
+	MemorySnapshotReader snapshotReader(snapshot);
+	if (!manager.LoadSnapshot(snapshotReader))
+		return false;
+	
+	_previous = std::move(current);
+	_sequence = sequence + 1;
+	return true;
+}
+
+void DeltaDecoder::Reset()
+{
+	_previous.clear();
+	_sequence = 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "Span.h"
+
+class ECSManager;
+
+/// The first bytes of every delta, "PCKD" in little endian
+constexpr std::uint32_t DELTA_MAGIC = 0x444B4350;
+
+/// The bytes of a part of a snapshot: the entities or the components of a type
+struct SnapshotSection
+{
+	/// Empty for the entities, the name of the type for components
+	std::string name;
+	
+	std::vector<char> bytes;
+	
+	/// The positions marked by SnapshotWriter::MarkBoundary, which split bytes into arrays
+	std::vector<std::size_t> boundaries;
+};
+
+using SnapshotSections = std::vector<SnapshotSection>;
+
+/// Records the changes of an ECSManager between consecutive calls of Encode as small deltas, e.g. for replays or
+/// rollback. Every array of the state is compared to its previous bytes: the entities and the free list, which
+/// covers created and destroyed entities, as well as the ids and components of every type, which covers added,
+/// removed and changed components. Only the XOR of the old and new bytes is stored, with runs of unchanged bytes
+/// left out.
+class DeltaEncoder
+{
+public:
+	/// Appends the changes of manager since the previous call to delta. The first delta after construction or
+	/// Reset holds the whole state.
+	/// \param manager
+	/// \param delta
+	void Encode(const ECSManager &manager, std::vector<char> &delta);
+	
+	/// Makes the next delta hold the whole state again
+	void Reset();
+
+private:
+	/// The state the next delta is relative to
+	SnapshotSections _previous;
+	
+	/// Reused for the state written by Encode
+	SnapshotSections _current;
+	
+	/// The number of deltas encoded since the last reset
+	std::uint64_t _sequence{0};
+};
+
+/// Applies the deltas of a DeltaEncoder to an ECSManager. Deltas have to be applied in the order they were encoded,
+/// starting with the first one after the encoder was constructed or reset.
+class DeltaDecoder
+{
+public:
+	/// Replaces the state of manager with the state the delta was encoded from. The manager is loaded like
+	/// ECSManager::LoadSnapshot does, so its previous content does not matter.
+	/// \param manager
+	/// \param delta
+	/// \return false if the delta is invalid or does not follow the previously applied one, nothing is changed then
+	bool Apply(ECSManager &manager, Span<const char> delta);
+	
+	/// Expects the next delta to hold the whole state
+	void Reset();
+
+private:
+	/// The state the last delta resulted in
+	SnapshotSections _previous;
+	
+	/// The number of deltas applied since the last full state
+	std::uint64_t _sequence{0};
+};
@@ -1,20 +1,67 @@
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <limits>
 #include "ECSManager.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
 
 
 ECSManager::~ECSManager()
 {
+	// jobs on the own thread pool may still use the components
+	_ownThreadPool.reset();
+	
+	// ComponentQueries may outlive the manager and must not unregister from it afterwards
+	for (std::vector<ComponentViewBase *> &systems : _componentSystems)
+	{
+		for (ComponentViewBase *system : systems)
+		{
+			if (system)
+				system->_registrySlots.clear();
+		}
+	}
+	
 	for (auto ComponentVector : _componentVectors)
 	{
 		delete ComponentVector.second;
 	}
 	
 	delete _deletedIndices;
+	delete _entities;
+}
+
+void ECSManager::BindToNumaNode(int numaNode)
+{
+	AssertNotIterating();
+	
+	_numaNode = numaNode;
+	for (auto &componentVector : _componentVectors)
+	{
+		componentVector.second->BindToNumaNode(numaNode);
+	}
+}
+
+void ECSManager::SetThreadPool(ctpl::thread_pool *pool)
+{
+	_threadPool = pool;
+	if (pool != _ownThreadPool.get())
+		_ownThreadPool.reset();
+}
+
+bool ECSManager::CreateThreadPool(const ThreadPoolConfig &config)
+{
+	auto pool = std::make_unique<ctpl::thread_pool>(0);
+	const bool allPinned = ConfigureThreadPool(*pool, config);
+	
+	_threadPool = pool.get();
+	_ownThreadPool = std::move(pool);
+	return allPinned;
 }
 
 Entity *ECSManager::GetEntity(EntityID id)
 {
-	if (id.Salt() == 0 || id.Index() == 0)
+	if (id.Salt() == 0 || id.Index() == 0 || id.Index() >= _entities->size())
 	{
 		return nullptr;
 	}
@@ -31,13 +78,16 @@ Entity *ECSManager::GetEntity(EntityID id)
 
 EntityID ECSManager::AddEntity()
 {
+	AssertNotIterating();
+	
 	// check if we have indices saved in _deletedIndices
 	IndexType insertIndex;
 	
-	if (!_deletedIndices->empty())
+	std::size_t deletedBegin, deletedEnd;
+	if (TakeDeletedIndices(1, deletedBegin, deletedEnd))
 	{
-		insertIndex = _deletedIndices->front();
-		_deletedIndices->pop_front();
+		insertIndex = (*_deletedIndices)[deletedBegin];
+		TrimDeletedIndices();
 	} else
 	{
 		insertIndex = _lastInsert;
@@ -52,13 +102,13 @@ EntityID ECSManager::AddEntity()
 		}
 	}
 	
+	// create id before resizing, as indices behind the entity list get their own salt
+	EntityID newID(insertIndex, NextSalt(insertIndex));
+	
 	// check if _entities can hold the entity, else resize it
 	if (_entities->size() <= insertIndex)
 		_entities->resize(insertIndex + 1);
 	
-	
-	// create id
-	EntityID newID(insertIndex, ((*_entities)[insertIndex].id.Salt()) + 1);
 	// assign to entity
 	(*_entities)[insertIndex].id = newID;
 	
@@ -66,72 +116,803 @@ EntityID ECSManager::AddEntity()
 	return newID;
 }
 
+void ECSManager::CommitReservations(EntityReserver &reserver)
+{
+	assert(reserver._manager == this && "The reserver belongs to another ECSManager!");
+	AssertNotIterating();
+	
+	// the entity list covers the whole fresh range, so that the unused indices given back below are dead entities
+	// like every other index of the free list
+	IndexType maxIndex = reserver._freshEnd > 0 ? reserver._freshEnd - 1 : 0;
+	for (EntityID id : reserver._reserved)
+	{
+		maxIndex = std::max(maxIndex, id.Index());
+	}
+	
+	if (_entities->size() <= maxIndex)
+		_entities->resize(maxIndex + 1);
+	
+	for (EntityID id : reserver._reserved)
+	{
+		(*_entities)[id.Index()].id = id;
+	}
+	
+	// give back what the reserver did not use
+	_deletedIndices->insert(_deletedIndices->end(), reserver._deletedIndices.begin(), reserver._deletedIndices.end());
+	for (IndexType index = reserver._freshBegin; index < reserver._freshEnd; ++index)
+	{
+		_deletedIndices->push_back(index);
+	}
+	
+	reserver._reserved.clear();
+	reserver._deletedIndices.clear();
+	reserver._freshBegin = reserver._freshEnd = 0;
+	
+	TrimDeletedIndices();
+}
+
+bool ECSManager::TakeDeletedIndices(std::size_t count, std::size_t &begin, std::size_t &end)
+{
+	const std::size_t nDeleted = _deletedIndices->size();
+	std::size_t head = _deletedBegin.load(std::memory_order_relaxed);
+	do
+	{
+		if (head >= nDeleted)
+			return false;
+		
+		end = std::min(head + count, nDeleted);
+	} while (!_deletedBegin.compare_exchange_weak(head, end, std::memory_order_relaxed));
+	
+	begin = head;
+	return true;
+}
+
+void ECSManager::TrimDeletedIndices()
+{
+	// erase the reused front once it makes up half of the list to keep the list from growing endlessly
+	const std::size_t deletedBegin = _deletedBegin;
+	if (deletedBegin < 64 || deletedBegin * 2 < _deletedIndices->size())
+		return;
+	
+	_deletedIndices->erase(_deletedIndices->begin(), _deletedIndices->begin() + deletedBegin);
+	_deletedBegin = 0;
+}
+
+SaltType ECSManager::NextSalt(IndexType index) const
+{
+	// indices that never held an entity may have been trimmed by Compact before
+	if (index >= _entities->size() || (*_entities)[index].id.Salt() == 0)
+		return _freshSalt;
+	
+	return (*_entities)[index].id.Salt() + 1;
+}
+
+EntityID EntityReserver::Reserve()
+{
+	ECSManager &manager = *_manager;
+	
+	while (true)
+	{
+		IndexType index;
+		if (!_deletedIndices.empty())
+		{
+			index = _deletedIndices.back();
+			_deletedIndices.pop_back();
+		} else if (_freshBegin < _freshEnd)
+		{
+			index = _freshBegin++;
+		} else
+		{
+			// take a new block of indices, preferring deleted ones
+			std::size_t deletedBegin, deletedEnd;
+			if (manager.TakeDeletedIndices(ENTITY_RESERVATION_BLOCK_SIZE, deletedBegin, deletedEnd))
+			{
+				// copied in reverse so that the indices are reused in the order they were deleted
+				_deletedIndices.assign(manager._deletedIndices->rend() - deletedEnd,
+				                       manager._deletedIndices->rend() - deletedBegin);
+			} else
+			{
+				_freshBegin = manager._lastInsert.fetch_add(ENTITY_RESERVATION_BLOCK_SIZE, std::memory_order_relaxed);
+				_freshEnd = _freshBegin + ENTITY_RESERVATION_BLOCK_SIZE;
+				assert(_freshEnd > _freshBegin && "Maximum capacity of Entities reached!");
+			}
+			continue;
+		}
+		
+		const EntityID id(index, manager.NextSalt(index));
+		_reserved.push_back(id);
+		return id;
+	}
+}
+
 bool ECSManager::DestroyEntity(EntityID id)
 {
+	PANCAKE_PROFILE_ZONE("ECSManager::DestroyEntity");
+	
 	Entity *pEntity = GetEntity(id);
 	
 	if (pEntity == nullptr)
 		return false;
 	
+	AssertNotIterating();
+	
+	// Remove the components one type at a time, so that every ComponentView the entity
+	// was part of is notified exactly once
+	const ComponentMask signature = pEntity->signature;
+	for (ComponentId componentType = 0; componentType < MAX_COMPONENT_TYPES; ++componentType)
+	{
+		if (signature.test(componentType))
+			RemoveComponentOfType(componentType, id);
+	}
+	
+	// removal hooks might have added entities, which invalidates pEntity
+	(*_entities)[id.Index()].id.MarkDead();
+	
+	
+	_deletedIndices->push_back(id.Index());
+	
+	return true;
+}
+
+void ECSManager::RemoveComponentOfType(ComponentId componentType, EntityID id)
+{
+	ComponentVectorBase *components = GetComponentsBase(componentType);
+	if (!components)
+		return;
+	
+	AssertNotIterating();
+	const EntityID movedId = components->RemoveComponentFrom(id);
+	NotifyOnRemove(componentType, id);
+	
+	if (movedId.IsAlive())
+		NotifyOnMove(componentType, movedId, components->getEntities().at(movedId));
+}
+
+void ECSManager::SaveSnapshot(SnapshotWriter &writer) const
+{
+	writer.WriteValue(SNAPSHOT_MAGIC);
+	writer.WriteValue(SNAPSHOT_VERSION);
+	WriteEntitySnapshot(writer);
+	
+	const std::vector<std::pair<ComponentId, ComponentVectorBase *>> componentVectors = SortedComponentVectors();
+	writer.WriteValue(static_cast<std::uint32_t>(componentVectors.size()));
+	for (const auto &[componentType, components] : componentVectors)
+	{
+		writer.WriteString(components->SnapshotName());
+		
+		// every type starts at an aligned position, so that its bytes do not depend on the types in front of it
+		writer.Align(SNAPSHOT_ARRAY_ALIGNMENT);
+		components->WriteSnapshot(writer);
+	}
+}
+
+void ECSManager::WriteEntitySnapshot(SnapshotWriter &writer) const
+{
+	// dead entities keep their salt, so that ids reusing their index stay distinct from older ones
+	writer.WriteValue(static_cast<std::uint64_t>(_entities->size()));
+	writer.WriteEntityIds(_entities->size(), [this](std::size_t i) { return (*_entities)[i].id; });
+	
+	const std::size_t deletedBegin = _deletedBegin;
+	const Span<const IndexType> deletedIndices(_deletedIndices->data() + deletedBegin,
+	                                           _deletedIndices->size() - deletedBegin);
+	writer.WriteValue(static_cast<std::uint64_t>(deletedIndices.Size()));
+	writer.MarkBoundary();
+	writer.WriteArray(deletedIndices);
+	writer.WriteValue(static_cast<IndexType>(_lastInsert));
+}
+
+std::vector<std::pair<ComponentId, ComponentVectorBase *>> ECSManager::SortedComponentVectors() const
+{
+	// sorted so that the same state always results in the same bytes
+	std::vector<std::pair<ComponentId, ComponentVectorBase *>> componentVectors(_componentVectors.begin(),
+	                                                                           _componentVectors.end());
+	std::sort(componentVectors.begin(), componentVectors.end());
+	return componentVectors;
+}
+
+bool ECSManager::LoadSnapshot(SnapshotReader &reader)
+{
+	AssertNotIterating();
+	
+	const auto magic = reader.ReadValue<std::uint32_t>();
+	const auto version = reader.ReadValue<std::uint32_t>();
+	const auto nEntities = reader.ReadValue<std::uint64_t>();
+	if (reader.Failed() || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION ||
+	    nEntities > std::numeric_limits<IndexType>::max())
+		return false;
+	
+	std::vector<Entity> entities(nEntities);
+	if (!reader.ReadEntityIds(nEntities, [&entities](std::size_t i) -> EntityID & { return entities[i].id; }))
+		return false;
+	
+	const auto nDeleted = reader.ReadValue<std::uint64_t>();
+	std::vector<IndexType> deletedIndices;
+	if (reader.Failed() || nDeleted > nEntities || !reader.ReadArray(deletedIndices, nDeleted))
+		return false;
+	
+	const auto lastInsert = reader.ReadValue<IndexType>();
+	const auto nTypes = reader.ReadValue<std::uint32_t>();
+	if (reader.Failed() || nTypes > MAX_COMPONENT_TYPES)
+		return false;
 	
-	// Notify all component systems on the removal of the entity and all
-	// possible components that the entity could have
-	for (auto &compSysVector : _componentSystems)
+	// everything is loaded next to the current state, which is only replaced once the snapshot turned out valid
+	tsl::robin_map<ComponentId, ComponentVectorBase *> componentVectors;
+	bool isValid = true;
+	for (std::uint32_t i = 0; i < nTypes && isValid; ++i)
 	{
-		NotifyOnRemove(compSysVector.first, id);
+		std::string name;
+		const SnapshotType *type = reader.ReadString(name) ? FindSnapshotType(name) : nullptr;
+		if (!type || componentVectors.count(type->id()) || !reader.Align(SNAPSHOT_ARRAY_ALIGNMENT))
+		{
+			isValid = false;
+			break;
+		}
+		
+		ComponentVectorBase *components = type->create(this, _numaNode);
+		componentVectors.insert(std::pair(type->id(), components));
+		isValid = components->ReadSnapshot(reader);
 	}
 	
-	// Remove all components of entity from componentVectors
-	for (auto &compVectorPair : _componentVectors)
+	for (std::size_t i = 0; i < nEntities && isValid; ++i)
 	{
-		compVectorPair.second->RemoveComponentFrom(id);
+		isValid = entities[i].id.Index() == 0 || entities[i].id.Index() == i;
 	}
 	
-	pEntity->id.MarkDead();
+	for (IndexType index : deletedIndices)
+	{
+		isValid = isValid && index != 0 && index < nEntities && !entities[index].IsAlive();
+	}
 	
+	// signatures are rebuilt as ComponentIds may differ between program runs
+	for (const auto &[componentType, components] : componentVectors)
+	{
+		const std::size_t nComponents = components->Size();
+		for (std::size_t i = 0; i < nComponents && isValid; ++i)
+		{
+			const EntityID id = components->IdAt(static_cast<IndexType>(i));
+			isValid = id.IsAlive() && id.Index() < nEntities && entities[id.Index()].id == id &&
+			          !entities[id.Index()].signature.test(componentType);
+			if (isValid)
+				entities[id.Index()].signature.set(componentType);
+		}
+	}
 	
-	_deletedIndices->push_back(id.Index());
+	if (!isValid)
+	{
+		for (const auto &[componentType, components] : componentVectors)
+		{
+			delete components;
+		}
+		return false;
+	}
+	
+	for (const auto &[componentType, components] : _componentVectors)
+	{
+		delete components;
+	}
+	_componentVectors = std::move(componentVectors);
+	
+	*_entities = std::move(entities);
+	*_deletedIndices = std::move(deletedIndices);
+	_deletedBegin = 0;
+	_lastInsert = std::max<IndexType>(lastInsert, 1);
+	
+	// the views look up the components of their types right away, which is why their maps from EntityID to index
+	// are filled here with every thread filling another type. The maps of other types are filled on first use.
+	std::vector<ComponentVectorBase *> viewedComponents;
+	for (const auto &[componentType, components] : _componentVectors)
+	{
+		if (componentType < _componentSystems.size() &&
+		    std::any_of(_componentSystems[componentType].begin(), _componentSystems[componentType].end(),
+		                [](const ComponentViewBase *system) { return system != nullptr; }))
+			viewedComponents.push_back(components);
+	}
+	ParallelFor(ThreadPool(), viewedComponents.size(), 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			static_cast<void>(viewedComponents[i]->getEntities());
+		}
+	});
+	
+	UpdateComponentSystems(ComponentMask().set());
+	return true;
+}
+
+bool ECSManager::SaveState(RollbackBuffer &buffer)
+{
+	AssertNotIterating();
+	
+	// a state missing the components of a type could not be restored
+	for (const auto &[componentType, componentVector] : _componentVectors)
+	{
+		if (!componentVector->IsCopyable())
+			return false;
+	}
+	
+	const SavedState *previous = buffer.Newest();
+	
+	// the copies of the overwritten state are reused, except for the ones still shared with other states
+	std::vector<SavedState::Components> components;
+	components.reserve(_componentVectors.size());
+	for (const auto &[componentType, componentVector] : _componentVectors)
+	{
+		const SavedState::Components *unchanged = previous ? previous->Find(componentType) : nullptr;
+		if (unchanged && componentVector->_stateStamp != 0 && unchanged->stamp == componentVector->_stateStamp)
+		{
+			components.push_back(*unchanged);
+			continue;
+		}
+		
+		SavedState &overwritten = buffer._states[(buffer._newest + 1) % buffer.Capacity()];
+		const SavedState::Components *reusable = overwritten.Find(componentType);
+		SavedState::Components saved{componentType, nullptr, 0, 0};
+		if (reusable && reusable->copy.use_count() == 1)
+			saved.copy = reusable->copy;
+		else
+			saved.copy.reset(componentVector->CreateEmpty(nullptr, _numaNode));
+		
+		// the map from id to index stays the same as long as no component was added or removed
+		const bool sameLayout = reusable && saved.copy == reusable->copy && componentVector->_layoutStamp != 0 &&
+		                        reusable->layoutStamp == componentVector->_layoutStamp;
+		saved.copy->CopyFrom(*componentVector, !sameLayout);
+		
+		if (componentVector->_layoutStamp == 0)
+			componentVector->_layoutStamp = RollbackBuffer::NextStamp();
+		componentVector->_stateStamp = RollbackBuffer::NextStamp();
+		saved.layoutStamp = componentVector->_layoutStamp;
+		saved.stamp = componentVector->_stateStamp;
+		components.push_back(std::move(saved));
+	}
+	
+	SavedState &state = buffer.Push();
+	state.components = std::move(components);
+	state.entities = *_entities;
+	state.deletedIndices.assign(_deletedIndices->begin() + _deletedBegin, _deletedIndices->end());
+	state.lastInsert = _lastInsert;
+	return true;
+}
+
+bool ECSManager::RestoreState(RollbackBuffer &buffer, std::size_t age)
+{
+	AssertNotIterating();
+	
+	if (age >= buffer.Size())
+		return false;
+	
+	buffer.Drop(age);
+	const SavedState &state = *buffer.Newest();
 	
+	ComponentMask relaidTypes;
+	for (const SavedState::Components &saved : state.components)
+	{
+		ComponentVectorBase *components = GetComponentsBase(saved.type);
+		if (!components)
+		{
+			components = saved.copy->CreateEmpty(this, _numaNode);
+			_componentVectors.insert(std::pair(saved.type, components));
+		}
+		
+		if (components->_stateStamp == saved.stamp)
+			continue;
+		
+		const bool sameLayout = components->_layoutStamp != 0 && components->_layoutStamp == saved.layoutStamp;
+		components->CopyFrom(*saved.copy, !sameLayout);
+		components->_stateStamp = saved.stamp;
+		components->_layoutStamp = saved.layoutStamp;
+		if (!sameLayout)
+			relaidTypes.set(saved.type);
+	}
+	
+	// types created after the state was saved had no components back then
+	for (const auto &[componentType, components] : _componentVectors)
+	{
+		if (!state.Find(componentType) && !components->getEntities().empty())
+		{
+			components->Clear();
+			relaidTypes.set(componentType);
+		}
+	}
+	
+	*_entities = state.entities;
+	*_deletedIndices = state.deletedIndices;
+	_deletedBegin = 0;
+	_lastInsert = state.lastInsert;
+	
+	UpdateComponentSystems(relaidTypes);
+	return true;
+}
+
+std::vector<EntityID> ECSManager::MoveEntities(Span<const EntityID> ids, ECSManager &destination)
+{
+	assert(&destination != this && "Entities can only be moved to another manager!");
+	AssertNotIterating();
+	destination.AssertNotIterating();
+	
+	// the new id of every moved entity at its index, which also moves ids given more than once only once
+	std::vector<EntityID> newIdAt(_entities->size());
+	std::vector<EntityID> movedIds;
+	movedIds.reserve(ids.Size());
+	EntityReserver reserver(destination);
+	for (EntityID id : ids)
+	{
+		if (GetEntity(id) && !newIdAt[id.Index()].IsAlive())
+		{
+			newIdAt[id.Index()] = reserver.Reserve();
+			movedIds.push_back(id);
+		}
+	}
+	destination.CommitReservations(reserver);
+	
+	std::vector<EntityID> owners;
+	std::vector<std::pair<IndexType, EntityID>> moved;
+	std::vector<IndexType> indices;
+	std::vector<EntityID> newComponentIds;
+	for (const auto &[componentType, components] : _componentVectors)
+	{
+		// the moved components in the order of their indices
+		moved.clear();
+		for (EntityID id : movedIds)
+		{
+			if ((*_entities)[id.Index()].signature.test(componentType))
+				moved.emplace_back(0, id);
+		}
+		
+		if (moved.empty())
+			continue;
+		
+		const bool movesAll = moved.size() == components->Size();
+		if (movesAll)
+		{
+			// every index is moved, which only needs the owner of every index instead of looking up every id
+			owners.resize(components->Size());
+			for (const auto &[id, index] : components->getEntities())
+			{
+				owners[index] = id;
+			}
+			
+			for (std::size_t i = 0; i < owners.size(); ++i)
+			{
+				moved[i] = std::pair(static_cast<IndexType>(i), owners[i]);
+			}
+		} else
+		{
+			for (auto &[index, id] : moved)
+			{
+				index = components->getEntities().at(id);
+			}
+			std::sort(moved.begin(), moved.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+		}
+		
+		indices.clear();
+		newComponentIds.clear();
+		for (const auto &[index, id] : moved)
+		{
+			indices.push_back(index);
+			newComponentIds.push_back(newIdAt[id.Index()]);
+		}
+		
+		ComponentVectorBase *target = destination.GetComponentsBase(componentType);
+		if (!target)
+		{
+			target = components->CreateEmpty(&destination, destination._numaNode);
+			destination._componentVectors.insert(std::pair(componentType, target));
+		}
+		
+		components->MoveComponentsTo(*target, indices, newComponentIds);
+		for (EntityID newId : newComponentIds)
+		{
+			destination.NotifyOnAdd(componentType, newId);
+		}
+		
+		if (movesAll)
+		{
+			// nothing is left, so the views of the type are rebuilt once instead of removing every entity
+			components->Clear();
+			for (const auto &[index, id] : moved)
+			{
+				(*_entities)[id.Index()].signature.reset(componentType);
+			}
+			UpdateComponentSystems(ComponentMask().set(componentType));
+			continue;
+		}
+		
+		// erasing from the back moves the fewest of the remaining components into the gaps
+		for (auto entry = moved.rbegin(); entry != moved.rend(); ++entry)
+		{
+			const EntityID movedId = components->EraseComponent(entry->second);
+			NotifyOnRemove(componentType, entry->second);
+			
+			if (movedId.IsAlive())
+				NotifyOnMove(componentType, movedId, components->getEntities().at(movedId));
+		}
+	}
+	
+	for (EntityID id : movedIds)
+	{
+		(*_entities)[id.Index()].id.MarkDead();
+		_deletedIndices->push_back(id.Index());
+	}
+	
+	// the moved entities keep their salt after they died, which tells them apart from older ids of their index
+	std::vector<EntityID> newIds(ids.Size());
+	for (std::size_t i = 0; i < ids.Size(); ++i)
+	{
+		const IndexType index = ids[i].Index();
+		if (index < newIdAt.size() && newIdAt[index].IsAlive() && (*_entities)[index].id.Salt() == ids[i].Salt())
+			newIds[i] = newIdAt[index];
+	}
+	return newIds;
+}
+
+std::vector<EntityID> ECSManager::Merge(ECSManager &source)
+{
+	std::vector<EntityID> ids;
+	for (const Entity &entity : *source._entities)
+	{
+		if (entity.IsAlive())
+			ids.push_back(entity.id);
+	}
+	
+	const std::vector<EntityID> newIds = source.MoveEntities(ids, *this);
+	
+	std::vector<EntityID> newIdsByIndex(source._entities->size());
+	for (std::size_t i = 0; i < ids.size(); ++i)
+	{
+		newIdsByIndex[ids[i].Index()] = newIds[i];
+	}
+	return newIdsByIndex;
+}
+
+std::unique_ptr<ECSManager> ECSManager::Fork()
+{
+	AssertNotIterating();
+	
+	// components that can not be copied could not be unshared once either side changes them
+	for (const auto &[componentType, components] : _componentVectors)
+	{
+		if (!components->IsCopyable())
+			return nullptr;
+	}
+	
+	auto fork = std::make_unique<ECSManager>();
+	*fork->_entities = *_entities;
+	fork->_deletedIndices->assign(_deletedIndices->begin() + _deletedBegin, _deletedIndices->end());
+	fork->_lastInsert = _lastInsert.load();
+	fork->_freshSalt = _freshSalt;
+	fork->_numaNode = _numaNode;
+	
+	for (const auto &[componentType, components] : _componentVectors)
+	{
+		fork->_componentVectors.insert(std::pair(componentType, components->Fork(fork.get())));
+	}
+	return fork;
+}
+
+MemoryStats ECSManager::GetMemoryStats() const
+{
+	MemoryStats stats{};
+	stats.entityBytes = _entities->capacity() * sizeof(Entity);
+	stats.deletedIndicesBytes = _deletedIndices->capacity() * sizeof(IndexType);
+	
+	for (const auto &[componentType, components] : SortedComponentVectors())
+	{
+		stats.components.push_back(components->GetMemoryStats());
+	}
+	
+	for (const auto &[queryType, query] : _queries)
+	{
+		if (const std::shared_ptr<ComponentViewBase> alive = query.lock())
+			stats.queries.push_back(alive->GetMemoryStats());
+	}
+	return stats;
+}
+
+bool ECSManager::Compact(const CompactPolicy &policy)
+{
+	PANCAKE_PROFILE_ZONE("ECSManager::Compact");
+	AssertNotIterating();
+	
+	const auto start = std::chrono::steady_clock::now();
+	
+	const std::vector<std::pair<ComponentId, ComponentVectorBase *>> componentVectors = SortedComponentVectors();
+	std::vector<std::shared_ptr<ComponentViewBase>> queries;
+	for (const auto &[queryType, query] : _queries)
+	{
+		if (std::shared_ptr<ComponentViewBase> alive = query.lock())
+			queries.push_back(std::move(alive));
+	}
+	
+	const std::size_t nSteps = 1 + componentVectors.size() + queries.size();
+	while (_compactStep < nSteps)
+	{
+		const std::size_t step = _compactStep++;
+		if (step == 0)
+			CompactEntities(policy);
+		else if (step <= componentVectors.size())
+			componentVectors[step - 1].second->ShrinkToFit(policy.minUsage);
+		else
+			queries[step - 1 - componentVectors.size()]->ShrinkToFit(policy.minUsage);
+		
+		if (policy.budget.count() > 0 && _compactStep < nSteps &&
+		    std::chrono::steady_clock::now() - start >= policy.budget)
+			return false;
+	}
+	
+	_compactStep = 0;
 	return true;
 }
 
+void ECSManager::CompactEntities(const CompactPolicy &policy)
+{
+	// forget the reused indices, which also keeps them from being mistaken for trimmed ones below
+	_deletedIndices->erase(_deletedIndices->begin(), _deletedIndices->begin() + _deletedBegin);
+	_deletedBegin = 0;
+	
+	if (policy.trimDeadEntities)
+	{
+		std::size_t newSize = _entities->size();
+		while (newSize > 1 && !(*_entities)[newSize - 1].IsAlive())
+		{
+			--newSize;
+		}
+		
+		if (newSize < _entities->size())
+		{
+			// ids of the trimmed entities must not become valid again once their indices are reused
+			for (std::size_t index = newSize; index < _entities->size(); ++index)
+			{
+				const SaltType salt = (*_entities)[index].id.Salt();
+				if (salt >= _freshSalt)
+					_freshSalt = salt == std::numeric_limits<SaltType>::max() ? 1 : static_cast<SaltType>(salt + 1);
+			}
+			
+			_entities->resize(newSize);
+			_deletedIndices->erase(std::remove_if(_deletedIndices->begin(), _deletedIndices->end(),
+			                                      [newSize](IndexType index) { return index >= newSize; }),
+			                       _deletedIndices->end());
+			_lastInsert = static_cast<IndexType>(std::max<std::size_t>(newSize, 1));
+		}
+	}
+	
+	if (IsWorthShrinking(_entities->size(), _entities->capacity(), policy.minUsage))
+		_entities->shrink_to_fit();
+	
+	if (IsWorthShrinking(_deletedIndices->size(), _deletedIndices->capacity(), policy.minUsage))
+		_deletedIndices->shrink_to_fit();
+}
+
 void ECSManager::RegisterComponentSystem(ComponentViewBase *system, const std::vector<ComponentId> &componentIds)
 {
 	for (ComponentId currId : componentIds)
 	{
-		if (_componentSystems.count(currId))
+		if (_componentSystems.size() <= currId)
+			_componentSystems.resize(currId + 1);
+		
+		system->_registrySlots.emplace_back(currId, _componentSystems[currId].size());
+		_componentSystems[currId].push_back(system);
+	}
+}
+
+void ECSManager::UnregisterComponentSystem(ComponentViewBase *system)
+{
+	for (const auto &[componentType, slot] : system->_registrySlots)
+	{
+		std::vector<ComponentViewBase *> &systems = _componentSystems[componentType];
+		
+		// erasing right away would skip systems in notifications that are currently iterating
+		if (_notifyDepth > 0)
 		{
-			_componentSystems.at(currId).push_back(system);
-		} else
+			systems[slot] = nullptr;
+			_hasUnregisteredSystems = true;
+			continue;
+		}
+		
+		// move the last system into the slot
+		ComponentViewBase *movedSystem = systems.back();
+		systems[slot] = movedSystem;
+		systems.pop_back();
+		
+		if (movedSystem && movedSystem != system)
+			movedSystem->SetRegistrySlot(componentType, slot);
+	}
+	
+	system->_registrySlots.clear();
+}
+
+void ECSManager::EraseUnregisteredSystems()
+{
+	for (ComponentId componentType = 0; componentType < _componentSystems.size(); ++componentType)
+	{
+		std::vector<ComponentViewBase *> &systems = _componentSystems[componentType];
+		systems.erase(std::remove(systems.begin(), systems.end(), nullptr), systems.end());
+		
+		for (std::size_t slot = 0; slot < systems.size(); ++slot)
+		{
+			systems[slot]->SetRegistrySlot(componentType, slot);
+		}
+	}
+	
+	_hasUnregisteredSystems = false;
+}
+
+void ECSManager::UpdateComponentSystems(const ComponentMask &componentTypes)
+{
+	// systems are registered once for every type they are interested in
+	std::vector<ComponentViewBase *> updatedSystems;
+	for (ComponentId componentType = 0; componentType < _componentSystems.size(); ++componentType)
+	{
+		if (!componentTypes.test(componentType))
+			continue;
+		
+		for (ComponentViewBase *system : _componentSystems[componentType])
 		{
-			std::vector<ComponentViewBase *> compSystems{system};
-			_componentSystems.insert(std::pair(currId, compSystems));
+			if (system && std::find(updatedSystems.begin(), updatedSystems.end(), system) == updatedSystems.end())
+				updatedSystems.push_back(system);
 		}
 	}
+	
+	for (ComponentViewBase *system : updatedSystems)
+	{
+		system->Update();
+	}
 }
 
 void ECSManager::NotifyOnAdd(ComponentId componentType, EntityID id)
 {
-	if (!_componentSystems.count(componentType))
+	PANCAKE_PROFILE_ZONE("ECSManager::NotifyOnAdd");
+	
+	Entity *pEntity = GetEntity(id);
+	assert(pEntity && "Components can only be added to alive entities!");
+	
+	if (!pEntity || pEntity->signature.test(componentType))
 		return;
 	
-	std::vector<ComponentViewBase *> interestedSystems = _componentSystems.at(componentType);
-	for (ComponentViewBase *compSystem : interestedSystems)
+	pEntity->signature.set(componentType);
+	const ComponentMask signature = pEntity->signature;
+	
+	ForeachComponentSystem(componentType, [&](ComponentViewBase &compSystem)
 	{
-		compSystem->OnComponentAdded(componentType, id);
-	}
+		// the system only cares about the entity if it owns all of its components now
+		if ((signature & compSystem.QueryMask()) == compSystem.QueryMask())
+			compSystem.OnComponentAdded(componentType, id);
+	});
 }
 
 void ECSManager::NotifyOnRemove(ComponentId componentType, EntityID id)
 {
-	if (!_componentSystems.count(componentType))
+	PANCAKE_PROFILE_ZONE("ECSManager::NotifyOnRemove");
+	
+	Entity *pEntity = GetEntity(id);
+	
+	if (!pEntity || !pEntity->signature.test(componentType))
 		return;
 	
-	std::vector<ComponentViewBase *> interestedSystems = _componentSystems.at(componentType);
-	for (ComponentViewBase *compSystem : interestedSystems)
+	const ComponentMask signature = pEntity->signature;
+	pEntity->signature.reset(componentType);
+	
+	ForeachComponentSystem(componentType, [&](ComponentViewBase &compSystem)
 	{
-		compSystem->OnComponentRemoved(componentType, id);
-	}
+		// the system only held the entity if it owned all of its components before
+		if ((signature & compSystem.QueryMask()) == compSystem.QueryMask())
+			compSystem.OnComponentRemoved(componentType, id);
+	});
+}
+
+void ECSManager::NotifyOnMove(ComponentId componentType, EntityID id, IndexType newIndex)
+{
+	Entity *pEntity = GetEntity(id);
+	
+	if (!pEntity)
+		return;
+	
+	const ComponentMask signature = pEntity->signature;
+	
+	ForeachComponentSystem(componentType, [&](ComponentViewBase &compSystem)
+	{
+		if ((signature & compSystem.QueryMask()) == compSystem.QueryMask())
+			compSystem.OnComponentMoved(componentType, id, newIndex);
+	});
 }
 
 ComponentVectorBase *ECSManager::GetComponentsBase(ComponentId componentType)
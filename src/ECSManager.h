@@ -1,15 +1,25 @@
 #pragma once
 
 #include <queue>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <typeindex>
 #include <cassert>
 #include "../libs/robin-map/include/tsl/robin_map.h"
 
 #include "ComponentData.h"
 #include "EntityID.h"
 #include "ComponentVector.h"
+#include "ComponentHooks.h"
+#include "Span.h"
 #include "TypeId.h"
 #include "ComponentViewBase.h"
 #include "Entity.h"
+#include "EntityReserver.h"
+#include "Snapshot.h"
+#include "RollbackBuffer.h"
+#include "MemoryStats.h"
 
 
 class ECSManager;
@@ -57,7 +67,7 @@ class ECSManager
 public:
 	ECSManager()
 	{
-		_deletedIndices = new std::deque<IndexType>();
+		_deletedIndices = new std::vector<IndexType>();
 		
 		_entities = new std::vector<Entity>();
 	}
@@ -71,6 +81,42 @@ public:
 	/// \return
 	EntityID AddEntity();
 	
+	/// Places all component arrays of the manager on the numaNode. Their memory is first touched by a cpu of the node,
+	/// so that an operating system placing memory pages at their first touch keeps them there. Component arrays
+	/// created later are placed on the node as well. References to components become invalid.
+	/// \param numaNode -1 to leave the placement to the operating system
+	void BindToNumaNode(int numaNode);
+	
+	/// \return The NUMA node the component arrays are placed on, -1 if the manager is not bound to a node
+	[[nodiscard]] int NumaNode() const
+	{
+		return _numaNode;
+	}
+	
+	/// Makes the parallel methods of the ComponentViews of the manager run on pool instead of the thread pool shared
+	/// by all managers, so that managers simulated on different threads do not compete for the same workers. Must not
+	/// be called while jobs of the manager are running.
+	/// \param pool nullptr for the shared thread pool, otherwise it needs to outlive the manager. ParallelFor runs
+	/// everything on the calling thread if pool has no threads, ScheduleForeach needs at least one.
+	void SetThreadPool(ctpl::thread_pool *pool);
+	
+	/// Gives the manager a thread pool of its own, e.g. pinned to the cores reserved for the thread that simulates
+	/// the manager
+	/// \param config
+	/// \return Whether every worker that should be pinned was pinned
+	bool CreateThreadPool(const ThreadPoolConfig &config);
+	
+	/// \return The thread pool used by the parallel methods of the ComponentViews of the manager
+	[[nodiscard]] ctpl::thread_pool &ThreadPool() const
+	{
+		return _threadPool ? *_threadPool : ComponentViewBase::ThreadPool();
+	}
+	
+	/// Turns all ids reserved by the reserver into alive entities and gives unused indices it took back to the
+	/// manager. The reserver can be used again afterwards.
+	/// \param reserver
+	void CommitReservations(EntityReserver &reserver);
+	
 	/// Removes a component from the ECS Manager and unregisters it from all ComponentSystems.
 	/// \param id Owner of the Component
 	/// \return Whether or not the component was successfully removed
@@ -83,6 +129,16 @@ public:
 	template<typename ComponentType>
 	ComponentHandle<ComponentType> AddComponent(EntityID id);
 	
+	/// Constructs the given ComponentType in place for the id, forwarding args to its constructor.
+	/// An already existing component of the id is replaced.
+	/// \tparam ComponentType Deriving from ComponentData
+	/// \param id Owner of the Component
+	/// \param args Arguments the component is constructed from
+	/// \return A reference to the component that stays valid until the next component of the same type is
+	/// added or removed
+	template<typename ComponentType, typename ...Args>
+	ComponentType &EmplaceComponent(EntityID id, Args &&... args);
+	
 	/// Returns a ComponentHandle to the Component that is owned by the id.
 	/// \tparam ComponentType
 	/// \param id
@@ -92,22 +148,136 @@ public:
 	
 	template<typename ComponentType>
 	void RemoveComponent(EntityID id);
+	
+	/// Adds a default constructed ComponentType to every id. Batch hooks of the type are executed once for all
+	/// ids that did not own the component yet.
+	/// \tparam ComponentType Deriving from ComponentData
+	/// \param ids Owners of the Components
+	template<typename ComponentType>
+	void AddComponents(Span<const EntityID> ids);
+	
+	/// Removes ComponentType from every id. Batch hooks of the type are executed once for all ids that owned
+	/// the component.
+	/// \tparam ComponentType Deriving from ComponentData
+	/// \param ids Owners of the Components
+	template<typename ComponentType>
+	void RemoveComponents(Span<const EntityID> ids);
+	
+	/// Writes all entities, the reusable entity indices and every ComponentVector into a snapshot. The components of
+	/// a type are written as a single block of bytes unless a ComponentSerializer was set for the type.
+	/// \param writer
+	void SaveSnapshot(SnapshotWriter &writer) const;
+	
+	/// Replaces all entities and components with the ones of a snapshot written by SaveSnapshot and rebuilds all
+	/// ComponentViews. Hooks are not executed and EntityReservers that did not commit yet become invalid.
+	/// \param reader
+	/// \return false if the snapshot is invalid or contains an unknown component type, the manager stays unchanged
+	bool LoadSnapshot(SnapshotReader &reader);
+	
+	/// Copies all entities and components into a new state of buffer, which overwrites its oldest state once it is
+	/// full. Components that were not written since the previous SaveState into the buffer are shared with the
+	/// previous state instead of copied.
+	/// \param buffer
+	/// \return false if the manager holds components of a type that is not copy constructible, buffer stays unchanged
+	bool SaveState(RollbackBuffer &buffer);
+	
+	/// Replaces all entities and components with a state of buffer and forgets the states saved after it, so the
+	/// next SaveState follows the restored state. Only components that were written since they were saved or
+	/// restored are copied, and only ComponentViews of types whose entities changed are rebuilt. Hooks are not
+	/// executed and EntityReservers that did not commit yet become invalid.
+	/// \param buffer
+	/// \param age 0 for the newest state, 1 for the one saved before it and so on
+	/// \return false if buffer holds no state of that age, the manager stays unchanged
+	bool RestoreState(RollbackBuffer &buffer, std::size_t age = 0);
+	
+	/// Moves entities with all their components into another manager, where they get new ids. Components of a type
+	/// are appended to the ComponentVector of destination in the order of their indices, so entities whose components
+	/// lie next to each other are moved as one block. Hooks are not executed.
+	/// \param ids The entities to move, ids that are not alive are ignored
+	/// \param destination Another manager
+	/// \return The new id of every entry of ids, an invalid EntityID for the ones that were not alive
+	std::vector<EntityID> MoveEntities(Span<const EntityID> ids, ECSManager &destination);
+	
+	/// Moves all entities of source into this manager. The ComponentVectors of source are appended as a whole and
+	/// left empty. Hooks are not executed.
+	/// \param source
+	/// \return The new id of every entity of source at the index of its old id, invalid EntityIDs at the other indices
+	std::vector<EntityID> Merge(ECSManager &source);
+	
+	/// Creates a manager holding the same entities and components, e.g. to simulate a few frames speculatively.
+	/// The components of a type are shared between the managers until either of them writes, adds or removes one of
+	/// them, which copies only the components of that type. The fork has no ComponentViews and can be used on another
+	/// thread than this manager. While the components of a type are shared, ComponentData::manager points to one of
+	/// the managers sharing them. It is changed to a remaining one once that manager copies its components or is
+	/// destroyed, which must not happen while the other side reads ComponentData::manager. The fork uses the shared
+	/// thread pool.
+	/// \return nullptr if the manager holds components of a type that is not copy constructible
+	[[nodiscard]] std::unique_ptr<ECSManager> Fork();
+	
+	/// Collects how many bytes the entities, the components of every type and every ComponentQuery hold, e.g. to find
+	/// component arrays that reserve far more than they use or maps that kept their buckets after entities were
+	/// destroyed. Containers are counted by their capacity, not by their size.
+	/// \return
+	[[nodiscard]] MemoryStats GetMemoryStats() const;
+	
+	/// Gives back the memory that the entity list, the component arrays, their maps from EntityID to index and the
+	/// entity lists of the ComponentViews hold beyond what they use, e.g. after most entities were destroyed. With a
+	/// budget the work is spread over several calls, each one continuing where the previous one stopped. References
+	/// to components become invalid, ids and indices of components stay the same. EntityReservers that did not
+	/// commit yet become invalid if dead entities are trimmed.
+	/// \param policy
+	/// \return Whether everything was compacted, false if the budget ran out and Compact needs to be called again
+	bool Compact(const CompactPolicy &policy = CompactPolicy());
 
 private:
 	/// The list of entities the system might hold
 	std::vector<Entity> *_entities;
 	
-	/// list of indices where entities were deleted
-	std::deque<IndexType> *_deletedIndices;
+	/// list of indices where entities were deleted, the ones in front of _deletedBegin are already reused
+	std::vector<IndexType> *_deletedIndices;
+	
+	/// The first index of _deletedIndices that can be reused
+	std::atomic<std::size_t> _deletedBegin{0};
 	
 	/// Maps the componentVectors to a given ComponentId that they are holding as a type
 	tsl::robin_map<ComponentId, ComponentVectorBase *> _componentVectors;
 	
-	/// Maps the componentSystems to a given ComponentId that they are interested in
-	tsl::robin_map<ComponentId, std::vector<ComponentViewBase *> > _componentSystems;
+	/// Lists the componentSystems interested in a ComponentId, indexed by the ComponentId.
+	/// Systems unregistered while a list is iterated are set to nullptr and erased once the iteration finished.
+	std::vector<std::vector<ComponentViewBase *> > _componentSystems;
+	
+	/// The ComponentQueries shared by all ComponentViews of the same ComponentTypes, keyed by the query type
+	tsl::robin_map<std::type_index, std::weak_ptr<ComponentViewBase> > _queries;
+	
+	/// How many notifications are currently iterating over _componentSystems
+	int _notifyDepth{0};
+	
+	/// Whether _componentSystems contains nullptr entries of systems unregistered during a notification
+	bool _hasUnregisteredSystems{false};
 	
 	/// place where the last insert of a new entity happened (if no index of _deletedIndices was used)
-	IndexType _lastInsert{1};
+	std::atomic<IndexType> _lastInsert{1};
+	
+	/// The NUMA node new component arrays are placed on, -1 if the manager is not bound to a node
+	int _numaNode{-1};
+	
+	/// The thread pool of the manager, nullptr for the shared thread pool
+	ctpl::thread_pool *_threadPool{nullptr};
+	
+	/// The thread pool created by CreateThreadPool
+	std::unique_ptr<ctpl::thread_pool> _ownThreadPool;
+	
+	/// The salt of entities at indices behind the entity list, higher than the salts of all trimmed entities
+	SaltType _freshSalt{1};
+	
+	/// The step an incremental Compact continues with: the entities first, then every ComponentVector and then every
+	/// ComponentQuery
+	std::size_t _compactStep{0};
+
+#ifndef NDEBUG
+	/// The number of iterations over components that are currently running
+	mutable std::atomic<int> _activeIterations{0};
+#endif
 	
 	template<typename>
 	friend
@@ -116,6 +286,16 @@ private:
 	template<typename ...>
 	friend
 	class ComponentView;
+	
+	template<typename ...>
+	friend
+	class ComponentQuery;
+	
+	friend class EntityReserver;
+	
+	friend class IterationScope;
+	
+	friend class DeltaEncoder;
 
 private:
 	
@@ -124,12 +304,69 @@ private:
 	/// \param componentId
 	void RegisterComponentSystem(ComponentViewBase *system, const std::vector<ComponentId> &componentIds);
 	
+	/// Removes the given system from all componentSystems it was registered in. Safe to call during a notification.
+	/// \param system
+	void UnregisterComponentSystem(ComponentViewBase *system);
+	
+	/// Erases the entries of systems that were unregistered during a notification
+	void EraseUnregisteredSystems();
+	
+	/// Rebuilds every registered system interested in one of the types from the current ComponentVectors
+	/// \param componentTypes
+	void UpdateComponentSystems(const ComponentMask &componentTypes);
+	
+	/// Writes the part of a snapshot in front of the ComponentVectors: the entities, the reusable entity indices
+	/// and the next fresh index
+	void WriteEntitySnapshot(SnapshotWriter &writer) const;
+	
+	/// \return All ComponentVectors in the order they are written to snapshots
+	[[nodiscard]] std::vector<std::pair<ComponentId, ComponentVectorBase *>> SortedComponentVectors() const;
+	
+	/// Asserts in debug builds that no iteration over components is running, as adding or removing entities or
+	/// components would invalidate it
+	void AssertNotIterating() const
+	{
+		assert(_activeIterations == 0 && "Entities or components were changed during an iteration over components!");
+	}
+	
+	/// Takes up to count indices from _deletedIndices, safe to call from multiple threads at once
+	/// \return false if there were no deleted indices left
+	bool TakeDeletedIndices(std::size_t count, std::size_t &begin, std::size_t &end);
+	
+	/// Removes the already reused indices from the front of _deletedIndices
+	void TrimDeletedIndices();
+	
+	/// \return The salt the next entity at the index will have
+	SaltType NextSalt(IndexType index) const;
+	
+	/// Drops the dead entities at the end of the entity list if the policy says so and shrinks the entity list and
+	/// the reusable indices
+	void CompactEntities(const CompactPolicy &policy);
+	
+	/// Calls func for every system interested in componentType without copying the list of systems
+	/// \tparam Func void(ComponentViewBase &)
+	/// \param componentType
+	/// \param func
+	template<typename Func>
+	void ForeachComponentSystem(ComponentId componentType, Func func);
+	
+	/// Removes the component of the given type from the id and notifies the ComponentViews about the removal
+	/// \param componentType
+	/// \param id
+	void RemoveComponentOfType(ComponentId componentType, EntityID id);
+	
 	/// Finds the vector of the given type
 	/// \tparam ComponentType Deriving from ComponentData
 	/// \return A vector of the given type or nullptr if there was not any
 	template<typename ComponentType>
 	ComponentVector<ComponentType> *GetComponents();
 	
+	/// Finds the vector of the given type and creates it if there was none yet
+	/// \tparam ComponentType Deriving from ComponentData
+	/// \return The vector of the given type
+	template<typename ComponentType>
+	ComponentVector<ComponentType> *GetOrCreateComponents();
+	
 	/// Similar to GetComponents, but returns only the ComponentVectorBase
 	/// \param componentType
 	/// \return
@@ -141,15 +378,63 @@ private:
 	template<typename ComponentType>
 	ComponentType *GetComponentDirect(EntityID id);
 	
-	/// Updates all ComponentViews active about newly added components
+	/// Returns the given component of the Entity without marking it as written
+	/// \tparam ComponentType Deriving from ComponentData
+	/// \return A pointer to the component or nullptr if the GameActor did not have the ComponentType
+	template<typename ComponentType>
+	const ComponentType *GetComponentDirect(EntityID id) const;
+	
+	/// Adds componentType to the signature of the entity and updates all ComponentViews the entity
+	/// starts to match
 	/// \param componentType
 	/// \param id
 	void NotifyOnAdd(ComponentId componentType, EntityID id);
 	
-	///  Updates all ComponentViews active about newly removed components
+	/// Removes componentType from the signature of the entity and updates all ComponentViews the entity
+	/// stops to match
 	/// \param componentType
 	/// \param id
 	void NotifyOnRemove(ComponentId componentType, EntityID id);
+	
+	/// Updates all ComponentViews holding the id about the new index of its component of componentType
+	/// \param componentType
+	/// \param id
+	/// \param newIndex
+	void NotifyOnMove(ComponentId componentType, EntityID id, IndexType newIndex);
+};
+
+
+/// Marks an iteration over the components of an ECSManager for as long as it exists. In debug builds adding or
+/// removing entities or components asserts that no iteration is marked.
+class IterationScope
+{
+public:
+	explicit IterationScope(const ECSManager &manager)
+#ifndef NDEBUG
+			: _manager(manager)
+	{
+		++_manager._activeIterations;
+	}
+#else
+	{
+	}
+#endif
+	
+	~IterationScope()
+	{
+#ifndef NDEBUG
+		--_manager._activeIterations;
+#endif
+	}
+	
+	IterationScope(const IterationScope &) = delete;
+	
+	IterationScope &operator=(const IterationScope &) = delete;
+
+#ifndef NDEBUG
+private:
+	const ECSManager &_manager;
+#endif
 };
 
 
@@ -224,7 +509,7 @@ const ComponentType &ComponentHandle<ComponentType>::operator*() const
 	assert(id.IsAlive() && "ID was not in use");
 	assert(_manager && "No ECS Manager found");
 	
-	ComponentType *componentP = _manager->GetComponentDirect<ComponentType>(id);
+	const ComponentType *componentP = std::as_const(*_manager).GetComponentDirect<ComponentType>(id);
 	assert(componentP != nullptr && "ComponentHandle is invalid");
 	return *componentP;
 }
@@ -247,7 +532,7 @@ const ComponentType *ComponentHandle<ComponentType>::operator->() const
 	assert(id.IsAlive() && "ID was not in use");
 	assert(_manager && "Manager must be set!");
 	
-	ComponentType *componentP = _manager->GetComponentDirect<ComponentType>(id);
+	const ComponentType *componentP = std::as_const(*_manager).GetComponentDirect<ComponentType>(id);
 	assert(id.IsAlive() && componentP != nullptr && "ComponentHandle is invalid");
 	
 	return componentP;
@@ -256,7 +541,7 @@ const ComponentType *ComponentHandle<ComponentType>::operator->() const
 template<typename ComponentType>
 bool ComponentHandle<ComponentType>::IsValid() const
 {
-	return id.IsAlive() && (_manager->GetComponentDirect<ComponentType>(id));
+	return id.IsAlive() && (std::as_const(*_manager).GetComponentDirect<ComponentType>(id));
 }
 
 ////////////////////////////////////////////////////////
@@ -269,33 +554,74 @@ ComponentHandle<ComponentType> ECSManager::AddComponent(EntityID id)
 	static_assert(std::is_base_of_v<ComponentData, ComponentType>,
 	              "ComponentType has to derive from ComponentData!");
 	
-	auto componentTypeId = TypeId<ComponentType>::GetId();
+	AssertNotIterating();
+	auto *pComponents = GetOrCreateComponents<ComponentType>();
 	
-	// check if we have an already existing ComponentVector for the type
-	if (_componentVectors.count(componentTypeId))
+	// check if a component belonging to the id already exists in the ComponentVector
+	if (pComponents->Contains(id))
+		return ComponentHandle<ComponentType>(id, *this);
+	
+	pComponents->AddComponent(id);
+	
+	if (ComponentHooks<ComponentType>::HasAddHooks())
+		pComponents->RunAddHooks(Span<const EntityID>(&id, 1));
+	
+	NotifyOnAdd(TypeId<ComponentType>::GetId(), id);
+	return ComponentHandle<ComponentType>(id, *this);
+}
+
+template<typename ComponentType>
+void ECSManager::AddComponents(Span<const EntityID> ids)
+{
+	static_assert(std::is_base_of_v<ComponentData, ComponentType>,
+	              "ComponentType has to derive from ComponentData!");
+	
+	AssertNotIterating();
+	auto *pComponents = GetOrCreateComponents<ComponentType>();
+	
+	std::vector<EntityID> addedIds;
+	addedIds.reserve(ids.Size());
+	for (EntityID id : ids)
 	{
-		auto *pComponents = static_cast<ComponentVector<ComponentType> *>(_componentVectors[componentTypeId]);
-		
-		// check if a component belonging to the id already exists in the ComponentVector
 		if (pComponents->Contains(id))
-			return ComponentHandle<ComponentType>(id, *this);
+			continue;
 		
 		pComponents->AddComponent(id);
-		
-		NotifyOnAdd(componentTypeId, id);
-		return ComponentHandle<ComponentType>(id, *this);
-	} else
+		addedIds.push_back(id);
+	}
+	
+	if (ComponentHooks<ComponentType>::HasAddHooks() && !addedIds.empty())
+		pComponents->RunAddHooks(addedIds);
+	
+	for (EntityID id : addedIds)
 	{
-		// else we need to add the type to componentVectors
-		auto *createdComponents = new ComponentVector<ComponentType>();
-		createdComponents->manager = this;
-		_componentVectors.insert(std::pair(componentTypeId, static_cast<ComponentVectorBase *>(createdComponents)));
-		
-		createdComponents->AddComponent(id);
+		NotifyOnAdd(TypeId<ComponentType>::GetId(), id);
+	}
+}
+
+template<typename ComponentType, typename... Args>
+ComponentType &ECSManager::EmplaceComponent(EntityID id, Args &&... args)
+{
+	static_assert(std::is_base_of_v<ComponentData, ComponentType>,
+	              "ComponentType has to derive from ComponentData!");
+	
+	auto *pComponents = GetOrCreateComponents<ComponentType>();
+	
+	const bool isNew = !pComponents->Contains(id);
+	if (isNew)
+		AssertNotIterating();
+	
+	ComponentType &component = pComponents->EmplaceComponent(id, std::forward<Args>(args)...);
+	
+	if (isNew)
+	{
+		if (ComponentHooks<ComponentType>::HasAddHooks())
+			pComponents->RunAddHooks(Span<const EntityID>(&id, 1));
 		
-		NotifyOnAdd(componentTypeId, id);
-		return ComponentHandle<ComponentType>(id, *this);
+		NotifyOnAdd(TypeId<ComponentType>::GetId(), id);
 	}
+	
+	return component;
 }
 
 template<typename ComponentType>
@@ -319,6 +645,26 @@ ComponentType *ECSManager::GetComponentDirect(EntityID id)
 	return component;
 }
 
+template<typename ComponentType>
+const ComponentType *ECSManager::GetComponentDirect(EntityID id) const
+{
+	static_assert(std::is_base_of_v<ComponentData, ComponentType>,
+	              "ComponentType has to derive from ComponentData!");
+	
+	auto found = _componentVectors.find(TypeId<ComponentType>::GetId());
+	if (found == _componentVectors.end())
+		return nullptr;
+	
+	const auto *componentVector = static_cast<const ComponentVector<ComponentType> *>(found->second);
+	
+	const ComponentType *component = componentVector->GetComponent(id);
+	
+	if (!component || !component->IsAlive())
+		return nullptr;
+	
+	return component;
+}
+
 template<typename ComponentType>
 ComponentHandle<ComponentType> ECSManager::GetComponent(EntityID id)
 {
@@ -330,6 +676,8 @@ ComponentVector<ComponentType> *ECSManager::GetComponents()
 {
 	static_assert(std::is_base_of_v<ComponentData, ComponentType>,
 	              "ComponentType has to derive from ComponentData!");
+	// types that are only ever loaded from snapshots and then viewed need to be known to LoadSnapshot as well
+	static_cast<void>(ComponentVector<ComponentType>::_isSnapshotType);
 	
 	auto componentTypeId = TypeId<ComponentType>::GetId();
 	
@@ -341,6 +689,24 @@ ComponentVector<ComponentType> *ECSManager::GetComponents()
 	return componentVector;
 }
 
+template<typename ComponentType>
+ComponentVector<ComponentType> *ECSManager::GetOrCreateComponents()
+{
+	auto componentTypeId = TypeId<ComponentType>::GetId();
+	
+	// check if we have an already existing ComponentVector for the type
+	auto found = _componentVectors.find(componentTypeId);
+	if (found != _componentVectors.end())
+		return static_cast<ComponentVector<ComponentType> *>(found->second);
+	
+	// else we need to add the type to componentVectors, which iterations may be looking up
+	AssertNotIterating();
+	auto *createdComponents = new ComponentVector<ComponentType>(_numaNode);
+	createdComponents->manager = this;
+	_componentVectors.insert(std::pair(componentTypeId, static_cast<ComponentVectorBase *>(createdComponents)));
+	return createdComponents;
+}
+
 
 template<typename ComponentType>
 void ECSManager::RemoveComponent(EntityID id)
@@ -348,15 +714,58 @@ void ECSManager::RemoveComponent(EntityID id)
 	static_assert(std::is_base_of_v<ComponentData, ComponentType>,
 	              "ComponentType has to derive from ComponentData!");
 	
-	auto componentTypeId = TypeId<ComponentType>::GetId();
+	RemoveComponentOfType(TypeId<ComponentType>::GetId(), id);
+}
+
+template<typename ComponentType>
+void ECSManager::RemoveComponents(Span<const EntityID> ids)
+{
+	static_assert(std::is_base_of_v<ComponentData, ComponentType>,
+	              "ComponentType has to derive from ComponentData!");
 	
-	// check if we have an already existing ComponentVector for the type
-	if (!_componentVectors.count(componentTypeId))
+	AssertNotIterating();
+	ComponentVector<ComponentType> *pComponents = GetComponents<ComponentType>();
+	if (!pComponents)
+		return;
+	
+	std::vector<EntityID> removedIds;
+	removedIds.reserve(ids.Size());
+	for (EntityID id : ids)
+	{
+		if (pComponents->Contains(id))
+			removedIds.push_back(id);
+	}
+	
+	if (ComponentHooks<ComponentType>::HasRemoveHooks() && !removedIds.empty())
+		pComponents->RunRemoveHooks(removedIds);
+	
+	for (EntityID id : removedIds)
+	{
+		const EntityID movedId = pComponents->RemoveComponent(id);
+		NotifyOnRemove(TypeId<ComponentType>::GetId(), id);
+		
+		if (movedId.IsAlive())
+			NotifyOnMove(TypeId<ComponentType>::GetId(), movedId, pComponents->IndexOf(movedId));
+	}
+}
+
+template<typename Func>
+void ECSManager::ForeachComponentSystem(ComponentId componentType, Func func)
+{
+	if (componentType >= _componentSystems.size())
 		return;
 	
-	auto *pComponents = static_cast<ComponentVector<ComponentType> *>(_componentVectors.at(componentTypeId));
+	++_notifyDepth;
 	
-	pComponents->RemoveComponent(id);
+	// iterate by index as systems registered by func may reallocate the list
+	for (std::size_t i = 0; i < _componentSystems[componentType].size(); ++i)
+	{
+		ComponentViewBase *system = _componentSystems[componentType][i];
+		if (system)
+			func(*system);
+	}
 	
-	NotifyOnRemove(componentTypeId, id);
+	--_notifyDepth;
+	if (_notifyDepth == 0 && _hasUnregisteredSystems)
+		EraseUnregisteredSystems();
 }
\ No newline at end of file
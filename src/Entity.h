@@ -1,12 +1,16 @@
 # pragma once
 
 #include "EntityID.h"
+#include "TypeId.h"
 
 class Entity
 {
 public:
 	EntityID id;
 	
+	/// The types of all components the entity owns
+	ComponentMask signature;
+	
 	[[nodiscard]] bool IsAlive() const
 	{
 		return id.IsAlive();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <limits>
 #include <unordered_map> // TODO: make hash work without including unordered_map
 
 typedef unsigned short SaltType;
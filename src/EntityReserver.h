@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include "EntityID.h"
+
+class ECSManager;
+
+/// The number of indices an EntityReserver takes from its ECSManager at once
+constexpr IndexType ENTITY_RESERVATION_BLOCK_SIZE = 64;
+
+/// Creates EntityIDs of an ECSManager without locking, so that multiple threads can create entities at the same time.
+/// Every thread needs its own EntityReserver. The reserved ids become alive entities once the reserver is passed to
+/// ECSManager::CommitReservations, which, like every other change to the manager, must not run concurrently with
+/// reservations.
+class EntityReserver
+{
+public:
+	explicit EntityReserver(ECSManager &manager)
+			: _manager(&manager)
+	{
+	}
+	
+	/// Reserves a new EntityID. Components can be added to it after it was committed.
+	/// \return
+	EntityID Reserve();
+	
+	/// \return The ids reserved since the last commit
+	[[nodiscard]] const std::vector<EntityID> &Reserved() const
+	{
+		return _reserved;
+	}
+
+private:
+	friend class ECSManager;
+	
+	ECSManager *_manager;
+	
+	/// Deleted indices of the manager this reserver took but did not use yet
+	std::vector<IndexType> _deletedIndices;
+	
+	/// The range of never used indices this reserver took
+	IndexType _freshBegin{0};
+	IndexType _freshEnd{0};
+	
+	std::vector<EntityID> _reserved;
+};
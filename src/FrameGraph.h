@@ -0,0 +1,170 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include "TypeId.h"
+#include "JobSystem.h"
+#include "ComponentViewBase.h"
+
+/// Executes systems as jobs on a thread pool, once per call of Run.
+/// Every system declares the component types it reads and writes. A system only waits for systems scheduled
+/// before it, of the same or an earlier frame, that write a type it accesses or read a type it writes, and for
+/// its own execution of the previous frame. Frames are therefore pipelined: systems of the next frame start as
+/// soon as the systems they conflict with are done, while unrelated systems of the previous frame keep running.
+/// Entities and components must not be added or removed while a frame is running, e.g. only after Wait.
+class FrameGraph
+{
+public:
+	explicit FrameGraph(ctpl::thread_pool &pool = ComponentViewBase::ThreadPool())
+			: _pool(pool)
+			  , _lastWrites(MAX_COMPONENT_TYPES)
+			  , _readsSinceWrite(MAX_COMPONENT_TYPES)
+	{
+	}
+	
+	~FrameGraph()
+	{
+		try
+		{
+			Wait();
+		}
+		catch (...)
+		{
+		}
+	}
+	
+	FrameGraph(const FrameGraph &) = delete;
+	
+	FrameGraph &operator=(const FrameGraph &) = delete;
+	
+	/// Adds a system that is executed every frame after the conflicting systems added before it
+	/// \param reads The component types the system reads, e.g. MaskOf<Position, Velocity>()
+	/// \param writes The component types the system writes
+	/// \param system
+	void AddSystem(ComponentMask reads, ComponentMask writes, std::function<void()> system)
+	{
+		_systems.push_back({reads, writes, std::move(system), JobHandle()});
+	}
+	
+	/// Schedules all systems for the next frame without waiting for the previous ones
+	/// \return A job that finishes once all systems of the frame finished
+	JobHandle Run()
+	{
+		std::vector<JobHandle> frameJobs;
+		frameJobs.reserve(_systems.size());
+		
+		for (System &system : _systems)
+		{
+			std::vector<JobHandle> dependencies{system.lastRun};
+			for (ComponentId type = 0; type < MAX_COMPONENT_TYPES; ++type)
+			{
+				if (system.reads.test(type) || system.writes.test(type))
+					dependencies.push_back(_lastWrites[type]);
+				
+				if (system.writes.test(type))
+				{
+					for (const auto &read : _readsSinceWrite[type])
+					{
+						dependencies.push_back(read.second);
+					}
+				}
+			}
+			
+			JobHandle job = ScheduleJob(_pool, system.func, dependencies);
+			
+			for (ComponentId type = 0; type < MAX_COMPONENT_TYPES; ++type)
+			{
+				if (system.writes.test(type))
+				{
+					_lastWrites[type] = job;
+					_readsSinceWrite[type].clear();
+				} else if (system.reads.test(type))
+				{
+					AddRead(_readsSinceWrite[type], static_cast<std::size_t>(&system - _systems.data()), job);
+				}
+			}
+			
+			system.lastRun = job;
+			frameJobs.push_back(job);
+		}
+		
+		// join the systems and pass on their exceptions
+		JobHandle frame = ScheduleJob(_pool, [frameJobs]()
+		{
+			for (const JobHandle &job : frameJobs)
+			{
+				job.Wait();
+			}
+		}, frameJobs);
+		
+		_runningFrames.erase(std::remove_if(_runningFrames.begin(), _runningFrames.end(),
+		                                    [](const JobHandle &runningFrame) { return runningFrame.IsDone(); }),
+		                     _runningFrames.end());
+		_runningFrames.push_back(frame);
+		return frame;
+	}
+	
+	/// Blocks until all scheduled frames finished and rethrows the first exception of a system
+	void Wait()
+	{
+		std::vector<JobHandle> runningFrames;
+		runningFrames.swap(_runningFrames);
+		
+		std::exception_ptr exception;
+		for (const JobHandle &frame : runningFrames)
+		{
+			try
+			{
+				frame.Wait();
+			}
+			catch (...)
+			{
+				if (!exception)
+					exception = std::current_exception();
+			}
+		}
+		
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+
+private:
+	struct System
+	{
+		ComponentMask reads;
+		ComponentMask writes;
+		std::function<void()> func;
+		
+		/// The job of the system in the last scheduled frame
+		JobHandle lastRun;
+	};
+	
+	/// The jobs reading a ComponentId and the indices of the systems they belong to
+	using Reads = std::vector<std::pair<std::size_t, JobHandle>>;
+	
+	/// Adds the job of system to reads. A job of the same system scheduled before is replaced, as job waits for it
+	/// anyway, and finished jobs are dropped, so that reads holds at most one job per system.
+	static void AddRead(Reads &reads, std::size_t system, const JobHandle &job)
+	{
+		reads.erase(std::remove_if(reads.begin(), reads.end(), [system](const auto &read)
+		{
+			return read.first == system || read.second.IsDone();
+		}), reads.end());
+		reads.emplace_back(system, job);
+	}
+	
+	ctpl::thread_pool &_pool;
+	
+	std::vector<System> _systems;
+	
+	/// The last scheduled job writing a ComponentId, indexed by the ComponentId
+	std::vector<JobHandle> _lastWrites;
+	
+	/// The jobs reading a ComponentId scheduled after its last writing job, indexed by the ComponentId
+	std::vector<Reads> _readsSinceWrite;
+	
+	/// The frames that were not known to be finished the last time Run was called
+	std::vector<JobHandle> _runningFrames;
+};
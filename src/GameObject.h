@@ -12,10 +12,17 @@
 class GameObject
 {
 public:
-	/// Creates a GameObject within the current scene
+	/// Creates a GameObject within the active scene of the calling thread
 	GameObject()
-			: scene(*Scene::ACTIVE_SCENE)
-			  , manager(Scene::ACTIVE_SCENE->manager)
+			: GameObject(*Scene::ACTIVE_SCENE)
+	{
+		assert(Scene::ACTIVE_SCENE != nullptr && "No active scene was found!");
+	}
+	
+	/// Creates a GameObject within the given scene
+	explicit GameObject(Scene &scene)
+			: manager(scene.manager)
+			  , scene(scene)
 	{
 	}
 	
@@ -25,12 +32,11 @@ public:
 			manager.DestroyEntity(_id);
 	}
 	
-	void Spawn(Scene &spawningScene = *Scene::ACTIVE_SCENE)
+	/// Creates the entity of the GameObject in the scene it was created within
+	void Spawn()
 	{
 		assert(!_id.IsAlive());
 		
-		scene = spawningScene;
-		manager = scene.manager;
 		_id = manager.AddEntity();
 		
 		OnSpawn();
@@ -70,6 +76,17 @@ public:
 		assert(_id.IsAlive()); // GameObject has not been spawned!
 		return manager.AddComponent<ComponentType>(_id);
 	}
+	
+	/// Constructs the given ComponentType in place from args
+	/// \tparam ComponentType Deriving from ComponentData
+	/// \param args Arguments the component is constructed from
+	/// \return A reference to the component, valid until the next component of the same type is added or removed
+	template<typename ComponentType, typename ...Args>
+	ComponentType &EmplaceComponent(Args &&... args)
+	{
+		assert(_id.IsAlive()); // GameObject has not been spawned!
+		return manager.EmplaceComponent<ComponentType>(_id, std::forward<Args>(args)...);
+	}
 
 protected:
 	virtual void OnSpawn()
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+/// Passes an object built on one thread, e.g. a Scene or ECSManager populated by a worker thread together with its
+/// primed ComponentViews, to another thread with a single atomic exchange. Everything the building thread did
+/// before Publish is visible to the thread that takes the object, neither thread ever blocks.
+/// \tparam T
+template<typename T>
+class Handoff
+{
+public:
+	Handoff() = default;
+	
+	~Handoff()
+	{
+		delete _published.exchange(nullptr, std::memory_order_acquire);
+	}
+	
+	Handoff(const Handoff &) = delete;
+	
+	Handoff &operator=(const Handoff &) = delete;
+	
+	/// Makes object available to Take. The object must not be used by the publishing thread anymore.
+	/// \param object
+	/// \return The previously published object if it was not taken yet
+	std::unique_ptr<T> Publish(std::unique_ptr<T> object)
+	{
+		return std::unique_ptr<T>(_published.exchange(object.release(), std::memory_order_acq_rel));
+	}
+	
+	/// \return The published object or nullptr if nothing was published since the last Take
+	std::unique_ptr<T> Take()
+	{
+		// checking first keeps polling every frame from writing to the shared cache line
+		if (_published.load(std::memory_order_relaxed) == nullptr)
+			return nullptr;
+		
+		return std::unique_ptr<T>(_published.exchange(nullptr, std::memory_order_acquire));
+	}
+
+private:
+	std::atomic<T *> _published{nullptr};
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <functional>
+#include "ctpl_stl.h"
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+class JobHandle;
+
+/// Executes work on the pool once all dependencies are finished. No thread blocks while waiting for them.
+/// Jobs still run if a dependency threw an exception.
+/// \param pool
+/// \param work
+/// \param dependencies
+/// \return A handle to the scheduled job
+inline JobHandle ScheduleJob(ctpl::thread_pool &pool, std::function<void()> work,
+                             const std::vector<JobHandle> &dependencies = {});
+
+/// A unit of work that is pushed to a thread pool once all jobs it depends on are finished
+class Job : public std::enable_shared_from_this<Job>
+{
+public:
+	Job(ctpl::thread_pool &pool, std::function<void()> work)
+			: _pool(pool)
+			  , _work(std::move(work))
+			  , _future(_promise.get_future().share())
+	{
+	}
+
+private:
+	friend class JobHandle;
+	
+	friend JobHandle ScheduleJob(ctpl::thread_pool &pool, std::function<void()> work,
+	                             const std::vector<JobHandle> &dependencies);
+	
+	/// Makes dependent wait for this job
+	/// \return false if this job has already finished
+	bool AddDependent(const std::shared_ptr<Job> &dependent)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_isDone)
+			return false;
+		
+		_dependents.push_back(dependent);
+		return true;
+	}
+	
+	/// Called once per finished dependency and once after scheduling, pushes the job once nothing is left
+	void ReleaseDependency()
+	{
+		if (--_pendingDependencies == 0)
+		{
+			_pool.push([job = shared_from_this()](int)
+			           {
+				           job->Execute();
+			           });
+		}
+	}
+	
+	void Execute()
+	{
+		try
+		{
+			_work();
+			_promise.set_value();
+		}
+		catch (...)
+		{
+			_promise.set_exception(std::current_exception());
+		}
+		_work = nullptr;
+		
+		std::vector<std::shared_ptr<Job>> dependents;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_isDone = true;
+			dependents.swap(_dependents);
+		}
+		
+		for (const std::shared_ptr<Job> &dependent : dependents)
+		{
+			dependent->ReleaseDependency();
+		}
+	}
+	
+	ctpl::thread_pool &_pool;
+	std::function<void()> _work;
+	
+	std::promise<void> _promise;
+	std::shared_future<void> _future;
+	
+	/// Starts at one so that the job is not pushed while its dependencies are still being added
+	std::atomic<int> _pendingDependencies{1};
+	
+	std::mutex _mutex;
+	bool _isDone{false};
+	std::vector<std::shared_ptr<Job>> _dependents;
+};
+
+/// Refers to a scheduled Job. Can be waited on, used as a dependency of other jobs or, with C++20,
+/// be co_awaited.
+class JobHandle
+{
+public:
+	/// An empty handle, which counts as done
+	JobHandle() = default;
+	
+	explicit JobHandle(std::shared_ptr<Job> job)
+			: _job(std::move(job))
+	{
+	}
+	
+	/// Blocks until the job finished and rethrows its exception, if it threw one
+	void Wait() const
+	{
+		if (_job)
+			_job->_future.get();
+	}
+	
+	[[nodiscard]] bool IsDone() const
+	{
+		return !_job || _job->_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+	
+	[[nodiscard]] bool IsValid() const
+	{
+		return _job != nullptr;
+	}
+
+#if defined(__cpp_impl_coroutine)
+	
+	bool await_ready() const
+	{
+		return IsDone();
+	}
+	
+	/// Resumes the coroutine on a thread of the pool once the job finished
+	void await_suspend(std::coroutine_handle<> coroutine) const
+	{
+		ScheduleJob(_job->_pool, [coroutine]() { coroutine.resume(); }, {*this});
+	}
+	
+	void await_resume() const
+	{
+		Wait();
+	}
+
+#endif
+
+private:
+	friend JobHandle ScheduleJob(ctpl::thread_pool &pool, std::function<void()> work,
+	                             const std::vector<JobHandle> &dependencies);
+	
+	std::shared_ptr<Job> _job;
+};
+
+inline JobHandle ScheduleJob(ctpl::thread_pool &pool, std::function<void()> work,
+                             const std::vector<JobHandle> &dependencies)
+{
+	auto job = std::make_shared<Job>(pool, std::move(work));
+	
+	for (const JobHandle &dependency : dependencies)
+	{
+		if (!dependency._job)
+			continue;
+		
+		++job->_pendingDependencies;
+		if (!dependency._job->AddDependent(job))
+			--job->_pendingDependencies;
+	}
+	
+	job->ReleaseDependency();
+	return JobHandle(job);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "../libs/robin-map/include/tsl/robin_map.h"
+#include "TypeId.h"
+
+/// The memory held by the ComponentVector of a type
+struct ComponentMemoryStats
+{
+	ComponentId type;
+	
+	/// The name identifying the type in snapshots
+	std::string name;
+	
+	/// sizeof the component type
+	std::size_t elementSize;
+	
+	/// The number of components
+	std::size_t count;
+	
+	/// The number of components the array can hold without growing
+	std::size_t capacity;
+	
+	/// The bytes allocated for the component array, including the padding behind its capacity
+	std::size_t componentBytes;
+	
+	/// The bytes of the buckets of the map from EntityID to index
+	std::size_t entityIndexBytes;
+	
+	/// The fraction of the buckets of the map from EntityID to index that is in use
+	float entityIndexLoadFactor;
+	
+	/// Whether the components are shared with a fork, which then holds the same bytes
+	bool isShared;
+};
+
+/// The memory held by a ComponentQuery, which is shared by all ComponentViews of its types
+struct QueryMemoryStats
+{
+	/// The component types of the query
+	std::string types;
+	
+	/// The number of entities in the query
+	std::size_t count;
+	
+	/// The bytes allocated for the component indices of every entity
+	std::size_t vectoredEntitiesBytes;
+	
+	/// The bytes of the buckets of the map from EntityID to position in the query
+	std::size_t registeredEntitiesBytes;
+	
+	/// The fraction of the buckets of the map from EntityID to position that is in use
+	float registeredEntitiesLoadFactor;
+	
+	/// The bytes allocated for the EntityID at every position
+	std::size_t viewedEntitiesBytes;
+	
+	[[nodiscard]] std::size_t TotalBytes() const
+	{
+		return vectoredEntitiesBytes + registeredEntitiesBytes + viewedEntitiesBytes;
+	}
+};
+
+/// The memory held by an ECSManager, as returned by ECSManager::GetMemoryStats. Only the memory of the containers is
+/// counted, not the memory behind them, e.g. heap memory owned by components.
+struct MemoryStats
+{
+	/// The bytes allocated for the entity list
+	std::size_t entityBytes;
+	
+	/// The bytes allocated for the list of reusable entity indices
+	std::size_t deletedIndicesBytes;
+	
+	/// One entry per component type, ordered by ComponentId
+	std::vector<ComponentMemoryStats> components;
+	
+	std::vector<QueryMemoryStats> queries;
+	
+	[[nodiscard]] std::size_t TotalBytes() const
+	{
+		std::size_t total = entityBytes + deletedIndicesBytes;
+		for (const ComponentMemoryStats &component : components)
+		{
+			total += component.componentBytes + component.entityIndexBytes;
+		}
+		for (const QueryMemoryStats &query : queries)
+		{
+			total += query.TotalBytes();
+		}
+		return total;
+	}
+};
+
+/// How ECSManager::Compact releases memory
+struct CompactPolicy
+{
+	/// Containers using less than this fraction of their capacity are shrunk to their size
+	float minUsage = 0.5f;
+	
+	/// Whether the dead entities at the end of the entity list are dropped. Fresh entities then continue at the index
+	/// behind the last alive entity, with salts higher than any dropped entity had.
+	bool trimDeadEntities = true;
+	
+	/// The time a single call of Compact may take, zero to compact everything at once. A single container is never
+	/// split, so every call shrinks at least one of them.
+	std::chrono::microseconds budget{0};
+};
+
+/// \return Whether a container holding size elements should give back its memory. Containers that fit into
+/// minCapacity elements are left alone.
+inline bool IsWorthShrinking(std::size_t size, std::size_t capacity, float minUsage, std::size_t minCapacity = 16)
+{
+	return capacity > minCapacity && static_cast<float>(size) < minUsage * static_cast<float>(capacity);
+}
+
+/// \return The bytes of the buckets of map, which keeps its buckets when elements are erased. Estimated from the
+/// layout of tsl::robin_map: every bucket holds an element behind the 16 bit distance to its ideal bucket and a flag
+/// marking the last bucket, padded to the alignment of the element. A hash it may store in that padding takes no
+/// extra bytes.
+template<typename Key, typename T>
+std::size_t BucketBytes(const tsl::robin_map<Key, T> &map)
+{
+	using Value = std::pair<Key, T>;
+	constexpr std::size_t headerBytes = sizeof(std::int16_t) + sizeof(bool);
+	constexpr std::size_t alignment = std::max(alignof(Value), alignof(std::int16_t));
+	constexpr std::size_t valueOffset = (headerBytes + alignof(Value) - 1) / alignof(Value) * alignof(Value);
+	constexpr std::size_t bucketBytes = (valueOffset + sizeof(Value) + alignment - 1) / alignment * alignment;
+	return map.bucket_count() * bucketBytes;
+}
+
+/// Rehashes map to the fewest buckets that fit its elements if it uses less than minUsage of the buckets it could use
+template<typename Key, typename T>
+void ShrinkBuckets(tsl::robin_map<Key, T> &map, float minUsage)
+{
+	const auto usableBuckets = static_cast<std::size_t>(static_cast<float>(map.bucket_count()) * map.max_load_factor());
+	if (IsWorthShrinking(map.size(), usableBuckets, minUsage))
+		map.rehash(0);
+}
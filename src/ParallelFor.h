@@ -0,0 +1,111 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+#include "ctpl_stl.h"
+
+/// \return The first element of range j when count elements are split into nRanges ranges whose sizes differ by
+/// at most one
+inline std::size_t RangeBegin(std::size_t count, std::size_t nRanges, std::size_t j)
+{
+	return j * count / nRanges;
+}
+
+/// The ranges of a ParallelFor, which the calling thread and the tasks it pushed to the pool claim one after another
+struct ParallelForRanges
+{
+	explicit ParallelForRanges(std::size_t nRanges)
+			: nRanges(nRanges)
+	{
+	}
+	
+	const std::size_t nRanges;
+	
+	/// The next range that was not claimed yet
+	std::atomic<std::size_t> nextRange{0};
+	
+	std::mutex mutex;
+	
+	/// Notified once all ranges were processed
+	std::condition_variable allDone;
+	
+	/// The number of processed ranges, guarded by mutex
+	std::size_t nDone{0};
+	
+	/// The first exception thrown by any range, guarded by mutex
+	std::exception_ptr exception;
+	
+	/// Calls func for every range that was not claimed yet
+	template<typename Func>
+	void Process(std::size_t count, Func &func)
+	{
+		for (std::size_t j = nextRange++; j < nRanges; j = nextRange++)
+		{
+			std::exception_ptr thrown;
+			try
+			{
+				func(RangeBegin(count, nRanges, j), RangeBegin(count, nRanges, j + 1));
+			}
+			catch (...)
+			{
+				thrown = std::current_exception();
+			}
+			
+			const std::lock_guard<std::mutex> lock(mutex);
+			if (thrown && !exception)
+				exception = thrown;
+			if (++nDone == nRanges)
+				allDone.notify_all();
+		}
+	}
+};
+
+/// Splits [0, count) into contiguous ranges of at least grainSize elements, at most one per thread of the pool,
+/// and calls func(begin, end) for every range. The calling thread processes every range no worker started yet
+/// itself and returns once all ranges were processed, so func may call ParallelFor on the same pool, e.g. from a
+/// FrameGraph system, without waiting for workers that wait themselves. Exceptions thrown by func are rethrown on
+/// the calling thread.
+/// \tparam Func void(std::size_t begin, std::size_t end)
+/// \param pool
+/// \param count The number of elements
+/// \param grainSize The minimum number of elements of a range, ranges are only split off if they get at least
+/// this many elements
+/// \param func
+template<typename Func>
+void ParallelFor(ctpl::thread_pool &pool, std::size_t count, std::size_t grainSize, Func &&func)
+{
+	if (count == 0)
+		return;
+	
+	const std::size_t maxRanges = std::max(pool.size(), 1);
+	const std::size_t nRanges = std::clamp<std::size_t>(count / std::max<std::size_t>(grainSize, 1), 1, maxRanges);
+	
+	if (nRanges == 1)
+	{
+		func(std::size_t(0), count);
+		return;
+	}
+	
+	// the tasks may only start after all ranges were processed, they then find none left and do not touch func
+	const auto ranges = std::make_shared<ParallelForRanges>(nRanges);
+	for (std::size_t j = 1; j < nRanges; ++j)
+	{
+		pool.push([ranges, count, &func](int)
+		          {
+			          ranges->Process(count, func);
+		          });
+	}
+	
+	ranges->Process(count, func);
+	
+	// the ranges claimed by workers are running, so waiting for them can not wait for this thread
+	std::unique_lock<std::mutex> lock(ranges->mutex);
+	ranges->allDone.wait(lock, [&ranges]() { return ranges->nDone == ranges->nRanges; });
+	
+	if (ranges->exception)
+		std::rethrow_exception(ranges->exception);
+}
@@ -0,0 +1,132 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+
+#include <utility>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#endif
+
+namespace
+{
+#ifdef __linux__
+	/// \return The perf_event_attr type and config counting event
+	std::pair<std::uint32_t, std::uint64_t> EventConfig(PerfEvent event)
+	{
+		constexpr std::uint64_t readMiss = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+		switch (event)
+		{
+			case PerfEvent::Cycles:
+				return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+			case PerfEvent::Instructions:
+				return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+			case PerfEvent::L1DataMisses:
+				return {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | readMiss};
+			case PerfEvent::LastLevelCacheMisses:
+				return {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | readMiss};
+			case PerfEvent::BranchMisses:
+				return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+		}
+		return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+	}
+	
+	/// Opens a counter of event for the calling thread on any cpu
+	/// \param groupFd The leader of the group to join, -1 to open a new group
+	/// \return The file descriptor of the counter or -1 if the system cannot count event
+	int OpenEvent(PerfEvent event, int groupFd)
+	{
+		perf_event_attr attr{};
+		attr.size = sizeof(attr);
+		attr.type = EventConfig(event).first;
+		attr.config = EventConfig(event).second;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+	}
+#endif
+}
+
+const char *PerfEventName(PerfEvent event)
+{
+	switch (event)
+	{
+		case PerfEvent::Cycles:
+			return "cycles";
+		case PerfEvent::Instructions:
+			return "instructions";
+		case PerfEvent::L1DataMisses:
+			return "L1D misses";
+		case PerfEvent::LastLevelCacheMisses:
+			return "LLC misses";
+		case PerfEvent::BranchMisses:
+			return "branch misses";
+	}
+	return "";
+}
+
+PerfCounters::PerfCounters()
+{
+	_fds.fill(-1);
+
+#ifdef __linux__
+	// all events are counted as one group, so that their counts cover the same time
+	for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+	{
+		_fds[i] = OpenEvent(static_cast<PerfEvent>(i), _groupFd);
+		if (_groupFd == -1)
+			_groupFd = _fds[i];
+	}
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+	// the group leader is closed last
+	for (std::size_t i = PERF_EVENT_COUNT; i-- > 0;)
+	{
+		if (_fds[i] != -1)
+			close(_fds[i]);
+	}
+#endif
+}
+
+bool PerfCounters::IsAvailable() const
+{
+	return _groupFd != -1;
+}
+
+PerfCounts PerfCounters::Read() const
+{
+	PerfCounts reading{};
+
+#ifdef __linux__
+	if (_groupFd == -1)
+		return reading;
+	
+	// the number of events, the time the group was enabled and running, followed by the count of every event in
+	// the order they were opened
+	std::uint64_t values[3 + PERF_EVENT_COUNT];
+	const ssize_t size = read(_groupFd, values, sizeof(values));
+	if (size < static_cast<ssize_t>(3 * sizeof(std::uint64_t)) || values[2] == 0)
+		return reading;
+	
+	// the hardware counters were only running for part of the time if the system shared them with other users
+	const double scale = static_cast<double>(values[1]) / static_cast<double>(values[2]);
+	std::size_t value = 3;
+	for (std::size_t i = 0; i < PERF_EVENT_COUNT && value < 3 + values[0]; ++i)
+	{
+		if (_fds[i] == -1)
+			continue;
+		
+		reading.counts[i] = static_cast<std::uint64_t>(static_cast<double>(values[value++]) * scale);
+		reading.isAvailable[i] = true;
+	}
+#endif
+
+	return reading;
+}
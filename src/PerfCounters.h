@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+/// The hardware events a PerfCounters counts
+enum class PerfEvent
+{
+	Cycles, Instructions, L1DataMisses, LastLevelCacheMisses, BranchMisses
+};
+
+constexpr std::size_t PERF_EVENT_COUNT = 5;
+
+/// The number of hardware events counted over a span of time
+struct PerfCounts
+{
+	std::array<std::uint64_t, PERF_EVENT_COUNT> counts{};
+	
+	/// Whether the system could count the event, its count is 0 otherwise
+	std::array<bool, PERF_EVENT_COUNT> isAvailable{};
+	
+	[[nodiscard]] std::uint64_t Get(PerfEvent event) const
+	{
+		return counts[static_cast<std::size_t>(event)];
+	}
+	
+	[[nodiscard]] bool IsAvailable(PerfEvent event) const
+	{
+		return isAvailable[static_cast<std::size_t>(event)];
+	}
+	
+	/// \return The average count of event per entity, e.g. to tell whether a loop is bound by memory bandwidth
+	/// or latency
+	[[nodiscard]] double PerEntity(PerfEvent event, std::size_t entities) const
+	{
+		return entities == 0 ? 0.0 : static_cast<double>(Get(event)) / static_cast<double>(entities);
+	}
+	
+	/// \return The counts between an earlier reading and this one
+	PerfCounts operator-(const PerfCounts &earlier) const
+	{
+		PerfCounts difference = *this;
+		for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+		{
+			// counts scaled for shared hardware counters are estimates, which may decrease slightly
+			difference.counts[i] = counts[i] > earlier.counts[i] ? counts[i] - earlier.counts[i] : 0;
+			difference.isAvailable[i] = isAvailable[i] && earlier.isAvailable[i];
+		}
+		return difference;
+	}
+	
+	PerfCounts &operator+=(const PerfCounts &other)
+	{
+		for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+		{
+			counts[i] += other.counts[i];
+			isAvailable[i] = isAvailable[i] || other.isAvailable[i];
+		}
+		return *this;
+	}
+};
+
+/// \return The name of event as shown in reports
+const char *PerfEventName(PerfEvent event);
+
+/// Counts the hardware events of the thread that created it, excluding the time spent in the kernel. Uses
+/// perf_event_open on Linux and counts nothing elsewhere, or if the system does not allow it, e.g. because of
+/// /proc/sys/kernel/perf_event_paranoid or in virtual machines without access to the performance monitoring unit.
+/// Wrap a benchmark scenario with Start and Stop, or take the difference of two readings:
+/// \code
+/// PerfCounters counters;
+/// counters.Start();
+/// view.Foreach(update);
+/// const PerfCounts counts = counters.Stop();
+/// const double cyclesPerEntity = counts.PerEntity(PerfEvent::Cycles, view.Size());
+/// \endcode
+class PerfCounters
+{
+public:
+	PerfCounters();
+	
+	~PerfCounters();
+	
+	PerfCounters(const PerfCounters &) = delete;
+	
+	PerfCounters &operator=(const PerfCounters &) = delete;
+	
+	/// \return Whether any event is counted
+	[[nodiscard]] bool IsAvailable() const;
+	
+	/// \return The events counted since the counters were created, scaled up if the system had to share the hardware
+	/// counters with other users for part of the time
+	[[nodiscard]] PerfCounts Read() const;
+	
+	/// Remembers the current reading for Stop
+	void Start()
+	{
+		_start = Read();
+	}
+	
+	/// \return The events counted since the last Start
+	[[nodiscard]] PerfCounts Stop() const
+	{
+		return Read() - _start;
+	}
+
+private:
+	/// The file descriptor of every event, -1 for events the system could not count
+	std::array<int, PERF_EVENT_COUNT> _fds;
+	
+	/// The descriptor of the group all other events were opened in, -1 if no event could be counted
+	int _groupFd{-1};
+	
+	PerfCounts _start{};
+};
@@ -0,0 +1,253 @@
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include "Profiler.h"
+
+namespace
+{
+	/// The events recorded on a single thread
+	struct ThreadEvents
+	{
+		/// The tid of the thread in the trace
+		std::uint32_t id;
+		
+		std::string name;
+		
+		std::vector<ProfileEvent> events;
+		
+		std::vector<ProfileCounters> counters;
+	};
+	
+	std::atomic<bool> countersEnabled{false};
+	
+	/// The events of every thread that recorded any. They are kept after their thread ended, as e.g. the workers of
+	/// a thread pool that was resized may have recorded the events of the previous frame.
+	struct ThreadRegistry
+	{
+		std::mutex mutex;
+		
+		std::vector<std::unique_ptr<ThreadEvents>> threads;
+	};
+	
+	ThreadRegistry &Registry()
+	{
+		static ThreadRegistry registry;
+		return registry;
+	}
+	
+	/// \return The events of the calling thread, which are registered when the thread records its first event
+	ThreadEvents &EventsOfThisThread()
+	{
+		thread_local ThreadEvents *events = []()
+		{
+			ThreadRegistry &registry = Registry();
+			const std::lock_guard<std::mutex> lock(registry.mutex);
+			
+			auto threadEvents = std::make_unique<ThreadEvents>();
+			threadEvents->id = static_cast<std::uint32_t>(registry.threads.size() + 1);
+			threadEvents->name = "Thread " + std::to_string(threadEvents->id);
+			threadEvents->events.reserve(1024);
+			registry.threads.push_back(std::move(threadEvents));
+			return registry.threads.back().get();
+		}();
+		return *events;
+	}
+	
+	void WriteJsonString(std::ostream &stream, const char *string)
+	{
+		stream << '"';
+		for (const char *c = string; *c != '\0'; ++c)
+		{
+			switch (*c)
+			{
+				case '"':
+					stream << "\\\"";
+					break;
+				case '\\':
+					stream << "\\\\";
+					break;
+				default:
+					// control characters are not allowed in JSON strings
+					if (static_cast<unsigned char>(*c) < 0x20)
+						stream << ' ';
+					else
+						stream << *c;
+			}
+		}
+		stream << '"';
+	}
+	
+	/// Adds calls, entities and counts of total to the entry of totals with the same name and detail
+	void AddCounters(std::vector<ProfileCounters> &totals, const ProfileCounters &total)
+	{
+		for (ProfileCounters &existing : totals)
+		{
+			if (existing.name == total.name && existing.detail == total.detail)
+			{
+				existing.calls += total.calls;
+				existing.entities += total.entities;
+				existing.counts += total.counts;
+				return;
+			}
+		}
+		totals.push_back(total);
+	}
+	
+	/// Writes nanoseconds as the microseconds Chrome trace events use
+	void WriteMicroseconds(std::ostream &stream, std::uint64_t nanoseconds)
+	{
+		const std::uint64_t fraction = nanoseconds % 1000;
+		stream << nanoseconds / 1000 << '.' << static_cast<char>('0' + fraction / 100)
+		       << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+	}
+}
+
+void Profiler::Record(const ProfileEvent &event)
+{
+	EventsOfThisThread().events.push_back(event);
+}
+
+void Profiler::SetThreadName(std::string name)
+{
+	ThreadEvents &events = EventsOfThisThread();
+	
+	const std::lock_guard<std::mutex> lock(Registry().mutex);
+	events.name = std::move(name);
+}
+
+bool Profiler::WriteChromeTrace(std::ostream &stream)
+{
+	ThreadRegistry &registry = Registry();
+	const std::lock_guard<std::mutex> lock(registry.mutex);
+	
+	stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	for (const std::unique_ptr<ThreadEvents> &thread : registry.threads)
+	{
+		stream << (first ? "\n" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << thread->id
+		       << R"(,"args":{"name":)";
+		WriteJsonString(stream, thread->name.c_str());
+		stream << "}}";
+		first = false;
+		
+		for (const ProfileEvent &event : thread->events)
+		{
+			stream << ",\n{\"name\":";
+			WriteJsonString(stream, event.name);
+			stream << R"(,"cat":"PancakeECS","ph":"X","pid":1,"tid":)" << thread->id << ",\"ts\":";
+			WriteMicroseconds(stream, event.start);
+			stream << ",\"dur\":";
+			WriteMicroseconds(stream, event.duration);
+			if (event.detail)
+			{
+				stream << ",\"args\":{\"detail\":";
+				WriteJsonString(stream, event.detail);
+				stream << '}';
+			}
+			stream << '}';
+		}
+	}
+	stream << "\n]}\n";
+	
+	return static_cast<bool>(stream);
+}
+
+bool Profiler::WriteChromeTrace(const std::string &path)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+	
+	return WriteChromeTrace(static_cast<std::ostream &>(file)) && file.flush();
+}
+
+std::size_t Profiler::EventCount()
+{
+	ThreadRegistry &registry = Registry();
+	const std::lock_guard<std::mutex> lock(registry.mutex);
+	
+	std::size_t count = 0;
+	for (const std::unique_ptr<ThreadEvents> &thread : registry.threads)
+	{
+		count += thread->events.size();
+	}
+	return count;
+}
+
+void Profiler::Clear()
+{
+	ThreadRegistry &registry = Registry();
+	const std::lock_guard<std::mutex> lock(registry.mutex);
+	
+	for (const std::unique_ptr<ThreadEvents> &thread : registry.threads)
+	{
+		thread->events.clear();
+		thread->counters.clear();
+	}
+}
+
+void Profiler::EnableCounters(bool enable)
+{
+	countersEnabled = enable;
+}
+
+bool Profiler::AreCountersEnabled()
+{
+	return countersEnabled;
+}
+
+PerfCounters *Profiler::CountersOfThisThread()
+{
+	if (!countersEnabled.load(std::memory_order_relaxed))
+		return nullptr;
+	
+	// opened on first use, as the counters only count the thread that opened them
+	thread_local const std::unique_ptr<PerfCounters> counters = std::make_unique<PerfCounters>();
+	return counters->IsAvailable() ? counters.get() : nullptr;
+}
+
+void Profiler::RecordCounters(const char *name, const char *detail, std::size_t entities, const PerfCounts &counts)
+{
+	AddCounters(EventsOfThisThread().counters, ProfileCounters{name, detail, 1, entities, counts});
+}
+
+std::vector<ProfileCounters> Profiler::CounterTotals()
+{
+	ThreadRegistry &registry = Registry();
+	const std::lock_guard<std::mutex> lock(registry.mutex);
+	
+	std::vector<ProfileCounters> totals;
+	for (const std::unique_ptr<ThreadEvents> &thread : registry.threads)
+	{
+		for (const ProfileCounters &counters : thread->counters)
+		{
+			AddCounters(totals, counters);
+		}
+	}
+	return totals;
+}
+
+bool Profiler::WriteCounterReport(std::ostream &stream)
+{
+	for (const ProfileCounters &total : CounterTotals())
+	{
+		stream << total.name;
+		if (total.detail)
+			stream << " <" << total.detail << '>';
+		stream << ": " << total.calls << " calls, " << total.entities << " entities";
+		
+		for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+		{
+			const auto event = static_cast<PerfEvent>(i);
+			stream << ", " << PerfEventName(event) << ' ';
+			if (total.counts.IsAvailable(event))
+				stream << total.counts.PerEntity(event, total.entities);
+			else
+				stream << "n/a";
+		}
+		stream << " per entity\n";
+	}
+	return static_cast<bool>(stream);
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstdint>
+#include "PerfCounters.h"
+
+/// A timed section of code recorded by a ProfileZone
+struct ProfileEvent
+{
+	/// A string literal naming the zone
+	const char *name;
+	
+	/// Further information on the zone, e.g. the component types of a view, or nullptr. Needs to stay alive until
+	/// the events are exported.
+	const char *detail;
+	
+	/// The nanoseconds since the start of the profiler
+	std::uint64_t start;
+	
+	std::uint64_t duration;
+};
+
+/// The hardware events counted in all zones of the same name and detail, see Profiler::EnableCounters
+struct ProfileCounters
+{
+	const char *name;
+	
+	const char *detail;
+	
+	/// The number of times a zone was recorded
+	std::size_t calls;
+	
+	/// The number of entities the zones processed
+	std::size_t entities;
+	
+	PerfCounts counts;
+};
+
+/// Collects the ProfileEvents of all threads and exports them as Chrome trace events, which can be viewed in
+/// chrome://tracing or Perfetto to see how the work of every frame is spread over the threads.
+/// Zones are only recorded if the library is built with PANCAKE_PROFILING defined, otherwise every
+/// PANCAKE_PROFILE_ZONE is compiled out and the exported trace is empty.
+class Profiler
+{
+public:
+	/// \return Whether zones are recorded in this build
+	static constexpr bool IsEnabled()
+	{
+#ifdef PANCAKE_PROFILING
+		return true;
+#else
+		return false;
+#endif
+	}
+	
+	/// \return The nanoseconds since the start of the profiler
+	static std::uint64_t Now()
+	{
+		static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count());
+	}
+	
+	/// Appends event to the events of the calling thread without any synchronization
+	static void Record(const ProfileEvent &event);
+	
+	/// Names the calling thread in the exported trace, threads are numbered otherwise
+	static void SetThreadName(std::string name);
+	
+	/// Writes all recorded events as Chrome trace event JSON. Must not be called while zones are recorded on other
+	/// threads, e.g. call it between frames.
+	/// \param stream
+	/// \return Whether everything was written
+	static bool WriteChromeTrace(std::ostream &stream);
+	
+	/// Writes the trace to the file at path, see WriteChromeTrace(std::ostream &)
+	static bool WriteChromeTrace(const std::string &path);
+	
+	/// \return The number of events recorded on all threads
+	static std::size_t EventCount();
+	
+	/// Forgets all recorded events and counters but keeps their memory. Must not be called while zones are recorded
+	/// on other threads.
+	static void Clear();
+	
+	/// Makes the zones that process entities, like ComponentView::Foreach, count hardware events with PerfCounters.
+	/// Reading the counters takes a few system calls per zone, which is why they are off by default.
+	static void EnableCounters(bool enable);
+	
+	[[nodiscard]] static bool AreCountersEnabled();
+	
+	/// \return The counters of the calling thread, nullptr if counters are disabled or not available
+	static PerfCounters *CountersOfThisThread();
+	
+	/// Adds counts to the counters of the zones with the same name and detail on the calling thread
+	static void RecordCounters(const char *name, const char *detail, std::size_t entities, const PerfCounts &counts);
+	
+	/// \return The counters of every zone name and detail, summed up over all threads. Must not be called while
+	/// zones are recorded on other threads.
+	static std::vector<ProfileCounters> CounterTotals();
+	
+	/// Writes the counts per entity of CounterTotals as text, one line per zone
+	/// \param stream
+	/// \return Whether everything was written
+	static bool WriteCounterReport(std::ostream &stream);
+};
+
+/// Records the time from its construction to its destruction as a ProfileEvent of the calling thread
+class ProfileZone
+{
+public:
+	/// \param name A string literal naming the zone
+	/// \param detail Further information on the zone or nullptr, needs to stay alive until the events are exported
+	explicit ProfileZone(const char *name, const char *detail = nullptr)
+			: _name(name), _detail(detail), _start(Profiler::Now())
+	{
+	}
+	
+	~ProfileZone()
+	{
+		Profiler::Record(ProfileEvent{_name, _detail, _start, Profiler::Now() - _start});
+	}
+	
+	ProfileZone(const ProfileZone &) = delete;
+	
+	ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+	const char *_name;
+	const char *_detail;
+	std::uint64_t _start;
+};
+
+/// Counts the hardware events from its construction to its destruction if Profiler::EnableCounters was called
+class ProfileCounterZone
+{
+public:
+	/// \param name A string literal naming the zone
+	/// \param detail Further information on the zone or nullptr, needs to stay alive until the counters are read
+	/// \param entities The number of entities processed in the zone
+	ProfileCounterZone(const char *name, const char *detail, std::size_t entities)
+			: _name(name), _detail(detail), _entities(entities), _counters(Profiler::CountersOfThisThread())
+	{
+		if (_counters)
+			_start = _counters->Read();
+	}
+	
+	~ProfileCounterZone()
+	{
+		if (_counters)
+			Profiler::RecordCounters(_name, _detail, _entities, _counters->Read() - _start);
+	}
+	
+	ProfileCounterZone(const ProfileCounterZone &) = delete;
+	
+	ProfileCounterZone &operator=(const ProfileCounterZone &) = delete;
+
+private:
+	const char *_name;
+	const char *_detail;
+	std::size_t _entities;
+	PerfCounters *_counters;
+	PerfCounts _start{};
+};
+
+#define PANCAKE_PROFILE_CONCAT_INNER(a, b) a##b
+#define PANCAKE_PROFILE_CONCAT(a, b) PANCAKE_PROFILE_CONCAT_INNER(a, b)
+
+#ifdef PANCAKE_PROFILING
+/// Records the rest of the enclosing scope as a zone, see ProfileZone
+#define PANCAKE_PROFILE_ZONE(...) const ProfileZone PANCAKE_PROFILE_CONCAT(profileZone, __LINE__)(__VA_ARGS__)
+
+/// Counts the hardware events of the rest of the enclosing scope, see ProfileCounterZone
+#define PANCAKE_PROFILE_COUNTERS(name, detail, entities) \
+	const ProfileCounterZone PANCAKE_PROFILE_CONCAT(profileCounters, __LINE__)(name, detail, entities)
+#else
+#define PANCAKE_PROFILE_ZONE(...) static_cast<void>(0)
+#define PANCAKE_PROFILE_COUNTERS(name, detail, entities) static_cast<void>(0)
+#endif
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#include "Entity.h"
+#include "TypeId.h"
+
+class ComponentVectorBase;
+
+/// The entities and components of an ECSManager saved by ECSManager::SaveState
+struct SavedState
+{
+	/// The copy of the components of a type
+	struct Components
+	{
+		ComponentId type;
+		
+		/// A ComponentVector holding copies of the components, shared by consecutive states as long as the
+		/// components do not change
+		std::shared_ptr<ComponentVectorBase> copy;
+		
+		/// Identifies the content of copy
+		std::uint64_t stamp;
+		
+		/// Identifies which ids own the components of copy at which index
+		std::uint64_t layoutStamp;
+	};
+	
+	std::vector<Entity> entities;
+	
+	/// The reusable entity indices
+	std::vector<IndexType> deletedIndices;
+	
+	IndexType lastInsert{1};
+	
+	std::vector<Components> components;
+	
+	/// \return The copy of the components of type or nullptr if the state holds none
+	[[nodiscard]] const Components *Find(ComponentId type) const
+	{
+		for (const Components &saved : components)
+		{
+			if (saved.type == type)
+				return &saved;
+		}
+		return nullptr;
+	}
+};
+
+/// A ring of the last states of an ECSManager, e.g. for rolling back a few frames. States and the memory of their
+/// copies are reused once the ring is full, so saving the state every frame allocates nothing as long as the number
+/// of entities and components does not grow.
+class RollbackBuffer
+{
+public:
+	/// \param capacity The number of states kept, saving more overwrites the oldest one
+	explicit RollbackBuffer(std::size_t capacity = 8)
+			: _states(capacity)
+	{
+		assert(capacity > 0);
+	}
+	
+	[[nodiscard]] std::size_t Capacity() const
+	{
+		return _states.size();
+	}
+	
+	/// \return The number of saved states that can be restored
+	[[nodiscard]] std::size_t Size() const
+	{
+		return _size;
+	}
+	
+	/// Forgets all saved states, but keeps their memory
+	void Clear()
+	{
+		_size = 0;
+	}
+
+private:
+	friend class ECSManager;
+	
+	std::vector<SavedState> _states;
+	
+	/// The index of the newest state in _states
+	std::size_t _newest{0};
+	
+	std::size_t _size{0};
+	
+	/// Hands out stamps that are unique among all buffers, as a ComponentVector may be saved into several of them
+	inline static std::atomic<std::uint64_t> _lastStamp{0};
+	
+	static std::uint64_t NextStamp()
+	{
+		return ++_lastStamp;
+	}
+	
+	/// \return The newest state or nullptr if there is none
+	[[nodiscard]] const SavedState *Newest() const
+	{
+		return _size == 0 ? nullptr : &_states[_newest];
+	}
+	
+	/// Makes the oldest state, or the next unused one, the newest state
+	/// \return The state that needs to be overwritten
+	SavedState &Push()
+	{
+		_newest = (_newest + 1) % _states.size();
+		_size = std::min(_size + 1, _states.size());
+		return _states[_newest];
+	}
+	
+	/// Forgets the count newest states
+	void Drop(std::size_t count)
+	{
+		assert(count <= _size);
+		
+		_newest = (_newest + _states.size() - count % _states.size()) % _states.size();
+		_size -= count;
+	}
+};
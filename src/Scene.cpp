@@ -1,11 +1,16 @@
 #include "Scene.h"
 
-Scene *Scene::ACTIVE_SCENE = nullptr;
+thread_local Scene *Scene::ACTIVE_SCENE = nullptr;
 
 Scene::Scene()
+		: Scene(true)
+{
+}
+
+Scene::Scene(bool makeActive)
 		: manager()
 {
-	if (ACTIVE_SCENE == nullptr)
+	if (makeActive && ACTIVE_SCENE == nullptr)
 		ACTIVE_SCENE = this;
 }
 
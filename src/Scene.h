@@ -3,18 +3,26 @@
 
 #include "ECSManager.h"
 
+/// A world of entities. Every thread has its own active scene, so threads can each simulate their own scene with
+/// GameObjects and ComponentViews created without naming it.
 class Scene
 {
 public:
-	static Scene *ACTIVE_SCENE;
+	/// The active scene of the calling thread
+	static thread_local Scene *ACTIVE_SCENE;
 	
 	ECSManager manager;
 
 public:
 	Scene();
 	
+	/// \param makeActive Whether the scene becomes the active scene of the calling thread if there is none yet.
+	/// Scenes built on a worker thread and handed to another thread should not, as the worker would keep a
+	/// dangling active scene.
+	explicit Scene(bool makeActive);
+	
 	~Scene();
 	
-	/// Marks this scene as the currently active one
+	/// Marks this scene as the active one of the calling thread
 	void SetActive();
 };
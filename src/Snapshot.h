@@ -0,0 +1,493 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <typeinfo>
+#include <functional>
+#include <type_traits>
+#include "EntityID.h"
+#include "TypeId.h"
+#include "Span.h"
+#include "AlignedAllocator.h"
+
+class ComponentVectorBase;
+
+class ECSManager;
+
+/// The first bytes of every snapshot, "PCKS" in little endian
+constexpr std::uint32_t SNAPSHOT_MAGIC = 0x534B4350;
+
+/// The version of the snapshot format, snapshots of other versions are rejected
+constexpr std::uint32_t SNAPSHOT_VERSION = 4;
+
+/// The offset of every raw component array in a snapshot is a multiple of the alignment of the component arrays,
+/// so that the arrays of a snapshot held in an aligned buffer are copied between equally aligned addresses
+constexpr std::size_t SNAPSHOT_ARRAY_ALIGNMENT = COMPONENT_ALIGNMENT;
+
+/// The longest type name a snapshot may contain
+constexpr std::uint32_t SNAPSHOT_MAX_NAME_LENGTH = 4096;
+
+/// The number of EntityIDs converted at once while writing or reading them, which keeps the buffers small
+constexpr std::size_t SNAPSHOT_ID_CHUNK_SIZE = 16384;
+
+/// How the components of a ComponentVector are stored in a snapshot
+enum class SnapshotEncoding : std::uint8_t
+{
+	/// The dense component array as raw bytes, written and read with a single call
+	Raw = 0,
+	
+	/// Every component written and read by the ComponentSerializer of its type
+	Serializer = 1,
+	
+	/// No components, as the type can neither be copied as bytes nor has a ComponentSerializer. Loading the
+	/// snapshot leaves the type without any components.
+	Skipped = 2
+};
+
+/// A sink for snapshot bytes
+class SnapshotWriter
+{
+public:
+	virtual ~SnapshotWriter() = default;
+	
+	/// Appends size bytes of data to the snapshot
+	void Write(const void *data, std::size_t size)
+	{
+		WriteBytes(data, size);
+		_position += size;
+	}
+	
+	/// \return Whether writing any of the bytes failed
+	[[nodiscard]] virtual bool Failed() const = 0;
+	
+	/// \return The number of bytes written so far
+	[[nodiscard]] std::size_t Position() const
+	{
+		return _position;
+	}
+	
+	/// Marks the start of an array whose length may differ between two snapshots of the same manager, so that
+	/// the DeltaEncoder compares the bytes behind it with the bytes behind the same mark of the previous state
+	void MarkBoundary()
+	{
+		if (_boundaries)
+			_boundaries->push_back(_position);
+	}
+	
+	/// Makes MarkBoundary record the positions of the marks in boundaries
+	/// \param boundaries nullptr to stop recording
+	void RecordBoundaries(std::vector<std::size_t> *boundaries)
+	{
+		_boundaries = boundaries;
+	}
+	
+	/// Writes zeros until Position() is a multiple of alignment
+	void Align(std::size_t alignment)
+	{
+		static constexpr char zeros[64]{};
+		while (_position % alignment != 0)
+		{
+			Write(zeros, std::min(alignment - _position % alignment, sizeof(zeros)));
+		}
+	}
+	
+	/// Writes the bytes of a trivially copyable value
+	template<typename T>
+	void WriteValue(const T &value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written as bytes!");
+		Write(&value, sizeof(T));
+	}
+	
+	/// Writes the elements of a trivially copyable array as a single block
+	template<typename T>
+	void WriteArray(Span<const T> values)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written as bytes!");
+		if (!values.Empty())
+			Write(values.Data(), values.Size() * sizeof(T));
+	}
+	
+	void WriteString(const std::string &string)
+	{
+		WriteValue(static_cast<std::uint32_t>(string.size()));
+		Write(string.data(), string.size());
+	}
+	
+	/// Writes the indices of count ids followed by their salts, which leaves out the padding of EntityID
+	/// \tparam GetId EntityID(std::size_t i)
+	template<typename GetId>
+	void WriteEntityIds(std::size_t count, GetId getId)
+	{
+		MarkBoundary();
+		std::vector<IndexType> indices(std::min(count, SNAPSHOT_ID_CHUNK_SIZE));
+		for (std::size_t begin = 0; begin < count; begin += SNAPSHOT_ID_CHUNK_SIZE)
+		{
+			const std::size_t end = std::min(begin + SNAPSHOT_ID_CHUNK_SIZE, count);
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				indices[i - begin] = getId(i).Index();
+			}
+			WriteArray(Span<const IndexType>(indices.data(), end - begin));
+		}
+		
+		MarkBoundary();
+		std::vector<SaltType> salts(std::min(count, SNAPSHOT_ID_CHUNK_SIZE));
+		for (std::size_t begin = 0; begin < count; begin += SNAPSHOT_ID_CHUNK_SIZE)
+		{
+			const std::size_t end = std::min(begin + SNAPSHOT_ID_CHUNK_SIZE, count);
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				salts[i - begin] = getId(i).Salt();
+			}
+			WriteArray(Span<const SaltType>(salts.data(), end - begin));
+		}
+	}
+
+protected:
+	virtual void WriteBytes(const void *data, std::size_t size) = 0;
+
+private:
+	std::size_t _position{0};
+	
+	std::vector<std::size_t> *_boundaries{nullptr};
+};
+
+/// A source of snapshot bytes. Once a read failed all following reads fail as well.
+class SnapshotReader
+{
+public:
+	virtual ~SnapshotReader() = default;
+	
+	/// Copies the next size bytes of the snapshot to data
+	/// \return false if the snapshot did not contain size more bytes
+	bool Read(void *data, std::size_t size)
+	{
+		if (!ReadBytes(data, size))
+			return false;
+		
+		_position += size;
+		return true;
+	}
+	
+	/// Returns the next size bytes of the snapshot without copying them, if the reader holds the whole snapshot in
+	/// memory
+	/// \return nullptr if the reader cannot lend its bytes, in which case nothing was read, or if the snapshot did
+	/// not contain size more bytes, in which case Failed() is true
+	const char *Borrow(std::size_t size)
+	{
+		const char *data = BorrowBytes(size);
+		if (data)
+			_position += size;
+		return data;
+	}
+	
+	/// \return Whether reading any of the bytes failed
+	[[nodiscard]] virtual bool Failed() const = 0;
+	
+	/// \return The number of bytes read so far
+	[[nodiscard]] std::size_t Position() const
+	{
+		return _position;
+	}
+	
+	/// Skips the zeros written by SnapshotWriter::Align
+	bool Align(std::size_t alignment)
+	{
+		char padding[64];
+		while (!Failed() && _position % alignment != 0)
+		{
+			Read(padding, std::min(alignment - _position % alignment, sizeof(padding)));
+		}
+		return !Failed();
+	}
+	
+	/// Reads the bytes of a trivially copyable value
+	/// \return A value initialized T if the read failed
+	template<typename T>
+	T ReadValue()
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be read as bytes!");
+		T value{};
+		Read(&value, sizeof(T));
+		return value;
+	}
+	
+	/// Replaces the elements of values with count elements read as a single block
+	template<typename T>
+	bool ReadArray(std::vector<T> &values, std::size_t count)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be read as bytes!");
+		values.resize(count);
+		return count == 0 || Read(values.data(), count * sizeof(T));
+	}
+	
+	bool ReadString(std::string &string)
+	{
+		const auto length = ReadValue<std::uint32_t>();
+		if (Failed() || length > SNAPSHOT_MAX_NAME_LENGTH)
+			return false;
+		
+		string.resize(length);
+		return length == 0 || Read(string.data(), length);
+	}
+	
+	/// Reads count ids written by SnapshotWriter::WriteEntityIds
+	/// \tparam GetId EntityID &(std::size_t i), the place the id i is stored at
+	template<typename GetId>
+	bool ReadEntityIds(std::size_t count, GetId getId)
+	{
+		std::vector<IndexType> indices;
+		for (std::size_t begin = 0; begin < count; begin += SNAPSHOT_ID_CHUNK_SIZE)
+		{
+			const std::size_t end = std::min(begin + SNAPSHOT_ID_CHUNK_SIZE, count);
+			if (!ReadArray(indices, end - begin))
+				return false;
+			
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				getId(i) = EntityID(indices[i - begin], 0);
+			}
+		}
+		
+		std::vector<SaltType> salts;
+		for (std::size_t begin = 0; begin < count; begin += SNAPSHOT_ID_CHUNK_SIZE)
+		{
+			const std::size_t end = std::min(begin + SNAPSHOT_ID_CHUNK_SIZE, count);
+			if (!ReadArray(salts, end - begin))
+				return false;
+			
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				EntityID &id = getId(i);
+				id = EntityID(id.Index(), salts[i - begin]);
+			}
+		}
+		return true;
+	}
+
+protected:
+	virtual bool ReadBytes(void *data, std::size_t size) = 0;
+	
+	virtual const char *BorrowBytes(std::size_t)
+	{
+		return nullptr;
+	}
+
+private:
+	std::size_t _position{0};
+};
+
+/// Writes a snapshot to a std::ostream, which should be opened in binary mode
+class StreamSnapshotWriter : public SnapshotWriter
+{
+public:
+	explicit StreamSnapshotWriter(std::ostream &stream)
+			: _stream(stream)
+	{
+	}
+	
+	[[nodiscard]] bool Failed() const override
+	{
+		return !_stream.good();
+	}
+
+protected:
+	void WriteBytes(const void *data, std::size_t size) override
+	{
+		_stream.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+	}
+
+private:
+	std::ostream &_stream;
+};
+
+/// Reads a snapshot from a std::istream, which should be opened in binary mode
+class StreamSnapshotReader : public SnapshotReader
+{
+public:
+	explicit StreamSnapshotReader(std::istream &stream)
+			: _stream(stream)
+	{
+	}
+	
+	[[nodiscard]] bool Failed() const override
+	{
+		return _failed;
+	}
+
+protected:
+	bool ReadBytes(void *data, std::size_t size) override
+	{
+		if (_failed)
+			return false;
+		
+		_stream.read(static_cast<char *>(data), static_cast<std::streamsize>(size));
+		_failed = static_cast<std::size_t>(_stream.gcount()) != size;
+		return !_failed;
+	}
+
+private:
+	std::istream &_stream;
+	
+	bool _failed{false};
+};
+
+/// Appends a snapshot to a buffer in memory
+class MemorySnapshotWriter : public SnapshotWriter
+{
+public:
+	/// \param buffer The snapshot is appended to the current content of buffer
+	explicit MemorySnapshotWriter(std::vector<char> &buffer)
+			: _buffer(buffer)
+	{
+	}
+	
+	[[nodiscard]] bool Failed() const override
+	{
+		return false;
+	}
+
+protected:
+	void WriteBytes(const void *data, std::size_t size) override
+	{
+		_buffer.insert(_buffer.end(), static_cast<const char *>(data), static_cast<const char *>(data) + size);
+	}
+
+private:
+	std::vector<char> &_buffer;
+};
+
+/// Reads a snapshot from memory, which has to stay alive while reading. Components of trivially copyable types are
+/// copied straight from the snapshot into their arrays.
+class MemorySnapshotReader : public SnapshotReader
+{
+public:
+	explicit MemorySnapshotReader(Span<const char> snapshot)
+			: _snapshot(snapshot)
+	{
+	}
+	
+	[[nodiscard]] bool Failed() const override
+	{
+		return _failed;
+	}
+
+protected:
+	bool ReadBytes(void *data, std::size_t size) override
+	{
+		const char *source = BorrowBytes(size);
+		if (source && size != 0)
+			std::memcpy(data, source, size);
+		return source != nullptr;
+	}
+	
+	const char *BorrowBytes(std::size_t size) override
+	{
+		if (_failed || size > _snapshot.Size() - _offset)
+		{
+			_failed = true;
+			return nullptr;
+		}
+		
+		const char *data = _snapshot.Data() + _offset;
+		_offset += size;
+		return data;
+	}
+
+private:
+	Span<const char> _snapshot;
+	
+	std::size_t _offset{0};
+	
+	bool _failed{false};
+};
+
+/// Writes and reads the components of ComponentType in snapshots one at a time. Components of types without a
+/// serializer are stored as raw bytes, which requires them to be trivially copyable. A serializer is used even for
+/// trivially copyable types once it was set, e.g. for components holding pointers.
+/// The id and manager of a component are restored by the ECSManager and do not need to be written.
+/// \tparam ComponentType Deriving from ComponentData
+template<typename ComponentType>
+struct ComponentSerializer
+{
+public:
+	using WriteFunc = std::function<void(const ComponentType &component, SnapshotWriter &writer)>;
+	
+	/// Receives a default constructed component that it fills from the reader
+	using ReadFunc = std::function<void(ComponentType &component, SnapshotReader &reader)>;
+	
+	static void Set(WriteFunc write, ReadFunc read)
+	{
+		_write = std::move(write);
+		_read = std::move(read);
+	}
+	
+	static void Clear()
+	{
+		_write = nullptr;
+		_read = nullptr;
+	}
+	
+	[[nodiscard]] static bool HasSerializer()
+	{
+		return _write && _read;
+	}
+	
+	/// \return The name identifying ComponentType in snapshots, the implementation defined typeid name by default
+	static const std::string &Name()
+	{
+		return _name;
+	}
+	
+	/// Changes the name identifying ComponentType in snapshots, which allows loading snapshots written by other
+	/// builds of the program. The name needs to be unique among all component types.
+	static void SetName(std::string name)
+	{
+		_name = std::move(name);
+	}
+
+private:
+	template<typename>
+	friend
+	class ComponentVector;
+	
+	inline static WriteFunc _write{};
+	inline static ReadFunc _read{};
+	inline static std::string _name{typeid(ComponentType).name()};
+};
+
+/// Everything the ECSManager needs to know to recreate the ComponentVector of a type found in a snapshot
+struct SnapshotType
+{
+	const std::string &(*name)();
+	
+	ComponentId (*id)();
+	
+	/// Creates an empty ComponentVector of the type for the manager on the given NUMA node
+	ComponentVectorBase *(*create)(ECSManager *manager, int numaNode);
+};
+
+/// \return All component types that may be loaded from snapshots. Every type a ComponentVector is created for
+/// anywhere in the program registers itself before main runs.
+inline std::vector<SnapshotType> &SnapshotTypes()
+{
+	static std::vector<SnapshotType> types;
+	return types;
+}
+
+/// \return The registered type with the given name or nullptr if there is none
+inline const SnapshotType *FindSnapshotType(const std::string &name)
+{
+	for (const SnapshotType &type : SnapshotTypes())
+	{
+		if (type.name() == name)
+			return &type;
+	}
+	return nullptr;
+}
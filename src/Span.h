@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+/// A non owning view of a contiguous range of elements
+/// \tparam T The element type, const qualified for read only access
+template<typename T>
+class Span
+{
+public:
+	constexpr Span() = default;
+	
+	constexpr Span(T *data, std::size_t size)
+			: _data(data)
+			  , _size(size)
+	{
+	}
+	
+	/// Views the elements of a contiguous container such as std::vector
+	template<typename Container,
+			typename = std::enable_if_t<std::is_convertible_v<decltype(std::declval<Container &>().data()), T *>>>
+	constexpr Span(Container &container)
+			: _data(container.data())
+			  , _size(container.size())
+	{
+	}
+	
+	/// Allows converting a Span<T> to a Span<const T>
+	template<typename U, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+	constexpr Span(const Span<U> &other)
+			: _data(other.Data())
+			  , _size(other.Size())
+	{
+	}
+	
+	[[nodiscard]] constexpr T *Data() const
+	{
+		return _data;
+	}
+	
+	[[nodiscard]] constexpr std::size_t Size() const
+	{
+		return _size;
+	}
+	
+	[[nodiscard]] constexpr bool Empty() const
+	{
+		return _size == 0;
+	}
+	
+	constexpr T &operator[](std::size_t index) const
+	{
+		return _data[index];
+	}
+	
+	constexpr T *begin() const
+	{
+		return _data;
+	}
+	
+	constexpr T *end() const
+	{
+		return _data + _size;
+	}
+
+private:
+	T *_data{nullptr};
+	std::size_t _size{0};
+};
@@ -0,0 +1,173 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "ThreadAffinity.h"
+
+#ifdef __linux__
+
+#include <pthread.h>
+#include <sched.h>
+
+#endif
+
+namespace
+{
+	/// Parses a cpu list of the form "0-3,8,10-11"
+	std::vector<int> ParseCpuList(const std::string &list)
+	{
+		std::vector<int> cpus;
+		std::stringstream stream(list);
+		std::string range;
+		while (std::getline(stream, range, ','))
+		{
+			if (range.empty() || range == "\n")
+				continue;
+			
+			const std::size_t dash = range.find('-');
+			const int first = std::stoi(range.substr(0, dash));
+			const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; ++cpu)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}
+	
+	/// The cpus of every NUMA node, read once from the system
+	const std::vector<std::vector<int>> &NumaTopology()
+	{
+		static const std::vector<std::vector<int>> topology = []
+		{
+			std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+			for (int node = 0;; ++node)
+			{
+				std::ifstream cpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+				if (!cpuList)
+					break;
+				
+				std::string list;
+				std::getline(cpuList, list);
+				nodes.push_back(ParseCpuList(list));
+			}
+#endif
+			if (nodes.empty())
+			{
+				nodes.emplace_back();
+				for (int cpu = 0; cpu < static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)); ++cpu)
+				{
+					nodes.back().push_back(cpu);
+				}
+			}
+			return nodes;
+		}();
+		return topology;
+	}
+
+#ifdef __linux__
+
+	cpu_set_t MakeCpuSet(const std::vector<int> &cpus)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : cpus)
+		{
+			if (cpu >= 0 && cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &set);
+		}
+		return set;
+	}
+
+#endif
+}
+
+ThreadPoolConfig ThreadPoolConfig::PinnedToEveryCpu()
+{
+	ThreadPoolConfig config;
+	for (int node = 0; node < NumaNodeCount(); ++node)
+	{
+		for (int cpu : CpusOfNumaNode(node))
+		{
+			config.placements.push_back(WorkerPlacement{cpu, node});
+		}
+	}
+	config.threadCount = std::max(static_cast<int>(config.placements.size()), 1);
+	return config;
+}
+
+ThreadPoolConfig ThreadPoolConfig::OnNumaNode(int numaNode)
+{
+	ThreadPoolConfig config;
+	config.threadCount = std::max(static_cast<int>(CpusOfNumaNode(numaNode).size()), 1);
+	config.placements.push_back(WorkerPlacement{-1, numaNode});
+	return config;
+}
+
+int NumaNodeCount()
+{
+	return static_cast<int>(NumaTopology().size());
+}
+
+const std::vector<int> &CpusOfNumaNode(int numaNode)
+{
+	static const std::vector<int> noCpus;
+	const auto &topology = NumaTopology();
+	if (numaNode < 0 || numaNode >= static_cast<int>(topology.size()))
+		return noCpus;
+	
+	return topology[numaNode];
+}
+
+bool PinThread(std::thread &thread, const std::vector<int> &cpus)
+{
+	if (cpus.empty())
+		return false;
+#ifdef __linux__
+	const cpu_set_t set = MakeCpuSet(cpus);
+	return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+bool ConfigureThreadPool(ctpl::thread_pool &pool, const ThreadPoolConfig &config)
+{
+	pool.resize(std::max(config.threadCount, 1));
+	if (config.placements.empty())
+		return true;
+	
+	bool allPinned = true;
+	for (int i = 0; i < pool.size(); ++i)
+	{
+		const WorkerPlacement &placement = config.placements[i % config.placements.size()];
+		if (placement.cpu >= 0)
+			allPinned &= PinThread(pool.get_thread(i), {placement.cpu});
+		else if (placement.numaNode >= 0)
+			allPinned &= PinThread(pool.get_thread(i), CpusOfNumaNode(placement.numaNode));
+	}
+	return allPinned;
+}
+
+void FirstTouchOnNumaNode(void *memory, std::size_t size, int numaNode)
+{
+#ifdef __linux__
+	const std::vector<int> &cpus = CpusOfNumaNode(numaNode);
+	const int currentCpu = sched_getcpu();
+	const bool onNode = std::find(cpus.begin(), cpus.end(), currentCpu) != cpus.end();
+	
+	cpu_set_t previous;
+	if (!onNode && !cpus.empty() && pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) == 0)
+	{
+		const cpu_set_t nodeSet = MakeCpuSet(cpus);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(nodeSet), &nodeSet) == 0)
+		{
+			std::memset(memory, 0, size);
+			pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+			return;
+		}
+	}
+#endif
+	std::memset(memory, 0, size);
+}
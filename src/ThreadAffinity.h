@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cstddef>
+#include "ctpl_stl.h"
+
+/// Where a worker thread of a thread pool is allowed to run
+struct WorkerPlacement
+{
+	/// The cpu the worker is pinned to, -1 if it is not pinned to a single cpu
+	int cpu = -1;
+	
+	/// The NUMA node whose cpus the worker is pinned to if cpu is -1, -1 if the worker may run anywhere
+	int numaNode = -1;
+};
+
+/// The size of a thread pool and the placement of its workers
+struct ThreadPoolConfig
+{
+	int threadCount = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+	
+	/// Worker i is placed at placements[i % placements.size()]. No worker is pinned if placements is empty
+	std::vector<WorkerPlacement> placements{};
+	
+	/// \return A config with one worker per cpu of the system, each pinned to its cpu
+	static ThreadPoolConfig PinnedToEveryCpu();
+	
+	/// \return A config with one worker per cpu of the numaNode, all pinned to the cpus of the node
+	static ThreadPoolConfig OnNumaNode(int numaNode);
+};
+
+/// \return The number of NUMA nodes of the system, 1 if it does not expose any
+int NumaNodeCount();
+
+/// \return The cpus belonging to the numaNode, empty if the node does not exist. A system without NUMA support
+/// reports all of its cpus as node 0
+const std::vector<int> &CpusOfNumaNode(int numaNode);
+
+/// Restricts thread to run on the given cpus only
+/// \return Whether the platform supports pinning threads and the thread was pinned
+bool PinThread(std::thread &thread, const std::vector<int> &cpus);
+
+/// Resizes pool to config.threadCount and pins its workers as given by config.placements. Must not be called while
+/// the pool works on jobs.
+/// \return Whether every worker that should be pinned was pinned
+bool ConfigureThreadPool(ctpl::thread_pool &pool, const ThreadPoolConfig &config);
+
+/// Zeroes size bytes at memory while running on a cpu of the numaNode. Operating systems placing memory pages on the
+/// node that touches them first then place them on numaNode. Zeroes the memory on the current cpu if the calling
+/// thread cannot be moved to the node.
+void FirstTouchOnNumaNode(void *memory, std::size_t size, int numaNode);
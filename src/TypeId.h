@@ -1,12 +1,47 @@
 #pragma once
 
+#include <bitset>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
 
 typedef unsigned short ComponentId;
 
+#ifndef PANCAKE_MAX_COMPONENT_TYPES
+/// The number of distinct component types a program may use. Configure with -DPANCAKE_MAX_COMPONENT_TYPES=<n> to
+/// change it, as every translation unit needs to see the same value.
+#define PANCAKE_MAX_COMPONENT_TYPES 64
+#endif
+
+/// The number of distinct component types a program may use, which is also the number of bits of a ComponentMask
+constexpr ComponentId MAX_COMPONENT_TYPES = PANCAKE_MAX_COMPONENT_TYPES;
+
+static_assert(PANCAKE_MAX_COMPONENT_TYPES > 0 && PANCAKE_MAX_COMPONENT_TYPES < 65536,
+              "PANCAKE_MAX_COMPONENT_TYPES must fit into a ComponentId!");
+
+/// Holds one bit per ComponentId, e.g. for the set of components an entity owns
+typedef std::bitset<MAX_COMPONENT_TYPES> ComponentMask;
+
 struct BaseTypeId
 {
 protected:
-	inline static ComponentId lastId = 0;
+	/// Atomic, as types may be used for the first time on several threads at once
+	inline static std::atomic<ComponentId> lastId{0};
+	
+	/// \return The id of a type used for the first time. Aborts if there are more than MAX_COMPONENT_TYPES types, as
+	/// their ids would not fit into a ComponentMask.
+	static ComponentId NextId()
+	{
+		const ComponentId id = lastId++;
+		if (id >= MAX_COMPONENT_TYPES)
+		{
+			std::fprintf(stderr, "More than %u component types are used, increase PANCAKE_MAX_COMPONENT_TYPES!\n",
+			             static_cast<unsigned>(MAX_COMPONENT_TYPES));
+			std::abort();
+		}
+		return id;
+	}
 };
 
 template<typename T>
@@ -15,7 +50,16 @@ struct TypeId : public BaseTypeId
 public:
 	static ComponentId GetId()
 	{
-		static ComponentId id = lastId++;
+		static const ComponentId id = NextId();
 		return id;
 	}
-};
\ No newline at end of file
+};
+
+/// \return A ComponentMask with the bits of all ComponentTypes set
+template<typename ...ComponentTypes>
+ComponentMask MaskOf()
+{
+	ComponentMask mask;
+	(mask.set(TypeId<ComponentTypes>::GetId()), ...);
+	return mask;
+}
\ No newline at end of file
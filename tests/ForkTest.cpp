@@ -0,0 +1,186 @@
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "../src/ECSManager.h"
+
+namespace
+{
+	struct Position : ComponentData
+	{
+		int value;
+	};
+	
+	struct Health : ComponentData
+	{
+		int value;
+	};
+	
+	constexpr int N_FORKS = 4;
+	
+	constexpr std::size_t N_ENTITIES = 2000;
+	
+	/// Writes, adds and removes components of manager, the way a speculative simulation on its own thread would
+	void Simulate(ECSManager &manager, const std::vector<EntityID> &ids, int offset, unsigned seed)
+	{
+		std::mt19937 random(seed);
+		for (EntityID id : ids)
+		{
+			manager.GetComponent<Position>(id)->value += offset;
+		}
+		
+		for (std::size_t i = 0; i < ids.size() / 10; ++i)
+		{
+			const EntityID id = ids[random() % ids.size()];
+			if (manager.GetComponent<Health>(id).IsValid())
+				manager.RemoveComponent<Health>(id);
+			else
+				manager.EmplaceComponent<Health>(id, offset);
+		}
+	}
+	
+	/// \return Whether every Position of manager was changed by offset and points to a manager in owners
+	bool IsConsistent(ECSManager &manager, const std::vector<EntityID> &ids, int offset,
+	                  const std::vector<const ECSManager *> &owners)
+	{
+		for (std::size_t i = 0; i < ids.size(); ++i)
+		{
+			const ComponentHandle<Position> position = manager.GetComponent<Position>(ids[i]);
+			if (position->value != static_cast<int>(i) + offset)
+			{
+				std::printf("entity %zu has position %d instead of %d\n", i, position->value,
+				            static_cast<int>(i) + offset);
+				return false;
+			}
+			
+			if (std::find(owners.begin(), owners.end(), position->manager) == owners.end())
+			{
+				std::printf("entity %zu points to a manager that does not hold it\n", i);
+				return false;
+			}
+		}
+		return true;
+	}
+	
+	/// The parent and every fork write on their own thread at once, the forks are destroyed on their thread while
+	/// the others still write
+	bool WritingForks(unsigned seed)
+	{
+		ECSManager parent;
+		std::vector<EntityID> ids;
+		for (std::size_t i = 0; i < N_ENTITIES; ++i)
+		{
+			ids.push_back(parent.AddEntity());
+			parent.EmplaceComponent<Position>(ids.back(), static_cast<int>(i));
+			parent.EmplaceComponent<Health>(ids.back(), 100);
+		}
+		
+		std::vector<std::unique_ptr<ECSManager>> forks;
+		for (int i = 0; i < N_FORKS; ++i)
+		{
+			forks.push_back(parent.Fork());
+		}
+		
+		std::vector<char> isConsistent(N_FORKS, false);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < N_FORKS; ++i)
+		{
+			threads.emplace_back([&, i]()
+			{
+				Simulate(*forks[i], ids, i + 1, seed + i);
+				isConsistent[i] = IsConsistent(*forks[i], ids, i + 1, {forks[i].get()});
+				forks[i].reset();
+			});
+		}
+		
+		// the parent writes while the forks copy and drop the components it shares with them
+		Simulate(parent, ids, 100, seed + N_FORKS);
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+		
+		return std::all_of(isConsistent.begin(), isConsistent.end(), [](char consistent) { return consistent; }) &&
+		       IsConsistent(parent, ids, 100, {&parent});
+	}
+	
+	/// The parent is destroyed while forks that never wrote still share its components, which have to point to a
+	/// remaining fork afterwards
+	bool ReadingForks(unsigned seed)
+	{
+		std::vector<EntityID> ids;
+		auto parent = std::make_unique<ECSManager>();
+		for (std::size_t i = 0; i < N_ENTITIES; ++i)
+		{
+			ids.push_back(parent->AddEntity());
+			parent->EmplaceComponent<Position>(ids.back(), static_cast<int>(i));
+		}
+		
+		std::vector<std::unique_ptr<ECSManager>> forks;
+		for (int i = 0; i < N_FORKS; ++i)
+		{
+			forks.push_back(parent->Fork());
+		}
+		
+		// forks leave one after another on their own threads, the last one keeps the components
+		std::thread parentThread([&parent]() { parent.reset(); });
+		std::vector<std::thread> threads;
+		for (int i = 1; i < N_FORKS; ++i)
+		{
+			threads.emplace_back([&forks, &ids, i, seed]()
+			{
+				// some forks copy the components before they leave
+				if ((seed + i) % 2 == 0)
+					Simulate(*forks[i], ids, 0, seed + i);
+				forks[i].reset();
+			});
+		}
+		parentThread.join();
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+		
+		return IsConsistent(*forks[0], ids, 0, {forks[0].get()});
+	}
+	
+	struct MoveOnly : ComponentData
+	{
+		MoveOnly() = default;
+		
+		MoveOnly(MoveOnly &&) = default;
+		
+		MoveOnly &operator=(MoveOnly &&) = default;
+		
+		std::unique_ptr<int> value;
+	};
+	
+	/// Managers holding components that can not be copied can not be forked
+	bool RejectsMoveOnlyComponents()
+	{
+		ECSManager manager;
+		manager.EmplaceComponent<MoveOnly>(manager.AddEntity());
+		if (manager.Fork() != nullptr)
+		{
+			std::printf("a manager holding move only components was forked\n");
+			return false;
+		}
+		return true;
+	}
+}
+
+int main()
+{
+	for (unsigned round = 0; round < 20; ++round)
+	{
+		if (!WritingForks(round) || !ReadingForks(round))
+		{
+			std::printf("round %u failed\n", round);
+			return 1;
+		}
+	}
+	
+	return RejectsMoveOnlyComponents() ? 0 : 1;
+}
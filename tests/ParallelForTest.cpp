@@ -0,0 +1,231 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <functional>
+#include "../src/ComponentView.h"
+#include "../src/ParallelFor.h"
+#include "../src/FrameGraph.h"
+#include "../src/RollbackBuffer.h"
+
+namespace
+{
+	struct A : ComponentData
+	{
+		int value;
+	};
+	
+	struct B : ComponentData
+	{
+		int value;
+	};
+	
+	/// Checks that ParallelFor hands out every element exactly once for the given sizes
+	bool CoversEveryElementOnce(ctpl::thread_pool &pool, std::size_t count, std::size_t grainSize)
+	{
+		std::vector<int> visits(count, 0);
+		ParallelFor(pool, count, grainSize, [&visits](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				++visits[i];
+			}
+		});
+		
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (visits[i] != 1)
+			{
+				std::printf("ParallelFor visited element %zu of %zu %d times with grain size %zu and %d threads\n", i,
+				            count, visits[i], grainSize, pool.size());
+				return false;
+			}
+		}
+		return true;
+	}
+	
+	/// Applies the same updates serially and in parallel to a view of random size and compares the results
+	bool MatchesSerialResult(std::mt19937 &random, int round)
+	{
+		Scene scene(false);
+		ECSManager &manager = scene.manager;
+		manager.CreateThreadPool(ThreadPoolConfig{1 + static_cast<int>(random() % 12)});
+		
+		ComponentView<A, B> both(manager);
+		ComponentView<A> onlyA(manager);
+		
+		const std::size_t nEntities = random() % 5000;
+		std::vector<EntityID> ids;
+		for (std::size_t i = 0; i < nEntities; ++i)
+		{
+			const EntityID id = manager.AddEntity();
+			ids.push_back(id);
+			manager.EmplaceComponent<A>(id, 0);
+			if (random() % 4 != 0)
+				manager.EmplaceComponent<B>(id, 0);
+		}
+		
+		// destroyed entities leave the components out of order
+		for (std::size_t i = 0; i < nEntities / 10; ++i)
+		{
+			manager.DestroyEntity(ids[random() % nEntities]);
+		}
+		
+		const int grainSize = 1 + static_cast<int>(random() % 600);
+		both.Foreach([](A &a, B &b)
+		             {
+			             a.value += 1;
+			             b.value += 3;
+		             });
+		both.Parallel_foreach([](A &a, B &b)
+		                      {
+			                      a.value += 10;
+			                      b.value += 30;
+		                      }, grainSize);
+		onlyA.Parallel_foreach([](A &a) { a.value += 100; }, grainSize);
+		both.ParallelForeachChunk([](Span<A> a, Span<B> b, std::size_t count)
+		                          {
+			                          for (std::size_t i = 0; i < count; ++i)
+			                          {
+				                          a[i].value += 1000;
+				                          b[i].value += 3000;
+			                          }
+		                          }, static_cast<std::size_t>(grainSize));
+		
+		for (EntityID id : ids)
+		{
+			ComponentHandle<A> a = manager.GetComponent<A>(id);
+			ComponentHandle<B> b = manager.GetComponent<B>(id);
+			if (!a.IsValid())
+				continue;
+			
+			const int expectedA = b.IsValid() ? 1111 : 100;
+			if (a->value != expectedA || (b.IsValid() && b->value != 3033))
+			{
+				std::printf("round %d: entity %u has %d instead of %d\n", round, id.Index(), a->value, expectedA);
+				return false;
+			}
+		}
+		
+		const auto count = both.ParallelReduce<std::size_t>(0, [](const A &, const B &) { return std::size_t(1); },
+		                                                    std::plus<std::size_t>(), 1 + random() % 100);
+		if (count != both.Size())
+		{
+			std::printf("round %d: ParallelReduce counted %zu of %zu entities\n", round, count, both.Size());
+			return false;
+		}
+		return true;
+	}
+	
+	struct Mass : ComponentData
+	{
+		float value;
+	};
+	
+	/// Reduces floats before saving and after restoring the state, which rebuilds the view in another order
+	bool ReducesRestoredStateAlike(unsigned seed)
+	{
+		std::mt19937 random(seed);
+		Scene scene(false);
+		ECSManager &manager = scene.manager;
+		ComponentView<Mass> masses(manager);
+		
+		std::vector<EntityID> ids;
+		for (int i = 0; i < 5000; ++i)
+		{
+			ids.push_back(manager.AddEntity());
+			manager.EmplaceComponent<Mass>(ids.back(), std::uniform_real_distribution<float>(0, 1e6f)(random));
+		}
+		for (int i = 0; i < 500; ++i)
+		{
+			manager.DestroyEntity(ids[random() % ids.size()]);
+		}
+		
+		const auto total = [&masses]()
+		{
+			return masses.ParallelReduce<float>(0, [](const Mass &mass) { return mass.value; }, std::plus<float>(), 64);
+		};
+		const float saved = total();
+		
+		RollbackBuffer buffer;
+		manager.SaveState(buffer);
+		const EntityID added = manager.AddEntity();
+		manager.EmplaceComponent<Mass>(added, 1.0f);
+		manager.DestroyEntity(added);
+		manager.RestoreState(buffer);
+		
+		const float restored = total();
+		if (restored != saved)
+		{
+			std::printf("ParallelReduce summed %.9g after restoring the state instead of %.9g\n", restored, saved);
+			return false;
+		}
+		return true;
+	}
+	
+	/// Runs systems that call Parallel_foreach as jobs on the pool they split their work onto, which must not
+	/// deadlock when every worker runs such a system
+	bool NestedInFrameGraph()
+	{
+		Scene scene(false);
+		ECSManager &manager = scene.manager;
+		manager.CreateThreadPool(ThreadPoolConfig{2});
+		
+		ComponentView<A> as(manager);
+		ComponentView<B> bs(manager);
+		for (int i = 0; i < 100000; ++i)
+		{
+			const EntityID id = manager.AddEntity();
+			manager.EmplaceComponent<A>(id, 0);
+			manager.EmplaceComponent<B>(id, 0);
+		}
+		
+		FrameGraph graph(manager.ThreadPool());
+		graph.AddSystem(ComponentMask(), MaskOf<A>(), [&as]()
+		{
+			as.Parallel_foreach([](A &a) { ++a.value; }, 1000);
+		});
+		graph.AddSystem(ComponentMask(), MaskOf<B>(), [&bs]()
+		{
+			bs.Parallel_foreach([](B &b) { ++b.value; }, 1000);
+		});
+		
+		for (int frame = 0; frame < 20; ++frame)
+		{
+			graph.Run();
+		}
+		graph.Wait();
+		
+		bool isCorrect = true;
+		as.Foreach([&isCorrect](A &a) { isCorrect = isCorrect && a.value == 20; });
+		bs.Foreach([&isCorrect](B &b) { isCorrect = isCorrect && b.value == 20; });
+		if (!isCorrect)
+			std::printf("systems of a FrameGraph did not update every component once per frame\n");
+		return isCorrect;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(11);
+	
+	for (int round = 0; round < 200; ++round)
+	{
+		ctpl::thread_pool pool(1 + static_cast<int>(random() % 12));
+		if (!CoversEveryElementOnce(pool, random() % 10000, 1 + random() % 700))
+			return 1;
+	}
+	
+	for (int round = 0; round < 60; ++round)
+	{
+		if (!MatchesSerialResult(random, round))
+			return 1;
+	}
+	
+	for (unsigned seed = 0; seed < 10; ++seed)
+	{
+		if (!ReducesRestoredStateAlike(seed))
+			return 1;
+	}
+	
+	return NestedInFrameGraph() ? 0 : 1;
+}